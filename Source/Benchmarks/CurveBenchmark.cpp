@@ -0,0 +1,61 @@
+#include <iostream>
+#include "../CurvePositionCalculator.h"
+#include "../DefaultTreeGenerator.h"
+
+/** OriotoCurveBenchmark: times a curve rebuild, reading the nodes from the
+    tree, compiling them and rendering the 2048 point table, for curves of
+    3, 20, 200 and 2,000 nodes. Fails if the largest takes a millisecond
+    or more, the budget for imported curves.
+*/
+namespace
+{
+constexpr size_t numPoints = 2048;
+constexpr double budgetMs = 1.0;
+
+juce::ValueTree createCurve (int numNodes)
+{
+    juce::Array<Node> nodes;
+    auto handle = 2.0f / static_cast<float> (numNodes - 1) / 3.0f;
+    for (int i = 0; i < numNodes; i++)
+    {
+        auto x = juce::jmap (static_cast<float> (i), 0.0f, static_cast<float> (numNodes - 1), -1.0f, 1.0f);
+        Node node;
+        node.endPoint = {x, std::tanh (3.0f * x)};
+        node.controlPointOne = node.endPoint - juce::Point<float> (handle, 0.0f);
+        node.controlPointTwo = node.endPoint + juce::Point<float> (handle, 0.0f);
+        // every type, so the rebuild resolves them too
+        node.type = static_cast<SegmentType> (i % segmentTypeNames.size());
+        nodes.add (node);
+    }
+    juce::ValueTree curveBranch (id::ACTIVE_CURVE);
+    CurveBranch::setNodes (curveBranch, nodes, nullptr);
+    return curveBranch;
+}
+}
+
+int main()
+{
+    std::vector<float> table (numPoints);
+    double largestMs = 0.0;
+    for (auto numNodes : {3, 20, 200, 2000})
+    {
+        auto curveBranch = createCurve (numNodes);
+        CurvePositionCalculator cpc (curveBranch);
+        constexpr int numRuns = 200;
+
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        for (int run = 0; run < numRuns; run++)
+            cpc.reset (curveBranch);
+        auto readMs = (juce::Time::getMillisecondCounterHiRes() - start) / numRuns;
+
+        start = juce::Time::getMillisecondCounterHiRes();
+        for (int run = 0; run < numRuns; run++)
+            CurvePositionCalculator::renderTable (cpc.getNodes(), table.data(), numPoints);
+        auto renderMs = (juce::Time::getMillisecondCounterHiRes() - start) / numRuns;
+
+        std::cout << numNodes << " nodes: " << readMs + renderMs << " ms per rebuild ("
+                  << readMs << " ms reading and compiling, " << renderMs << " ms rendering)" << std::endl;
+        largestMs = readMs + renderMs;
+    }
+    return largestMs < budgetMs ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+#include <iostream>
+#include "../MainProcessor.h"
+
+/** OriotoInstanceBenchmark: times constructing 1, 100 and 1,000
+    processors, as a host does loading a session, and then preparing them
+    all to play, which is where the oversampling filters, the audio
+    thread's table and the scan bank are set up. The banks are built on
+    the shared builder, which is drained before the clock stops. Only
+    reports; there's no budget to fail.
+*/
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+
+    for (auto numInstances : {1, 100, 1000})
+    {
+        std::vector<std::unique_ptr<MainProcessor>> processors;
+        processors.reserve (static_cast<size_t> (numInstances));
+
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        for (int i = 0; i < numInstances; i++)
+            processors.push_back (std::make_unique<MainProcessor>());
+        auto constructMs = juce::Time::getMillisecondCounterHiRes() - start;
+
+        start = juce::Time::getMillisecondCounterHiRes();
+        for (auto& processor : processors)
+        {
+            processor->setPlayConfigDetails (2, 2, sampleRate, blockSize);
+            processor->prepareToPlay (sampleRate, blockSize);
+        }
+        // preparing schedules each scan bank on the shared builder, which counts too
+        juce::SharedResourcePointer<op::BackgroundBuilder>()->waitUntilIdle();
+        auto prepareMs = juce::Time::getMillisecondCounterHiRes() - start;
+
+        std::cout << numInstances << " instances: constructed in " << constructMs << " ms ("
+                  << constructMs * 1000.0 / numInstances << " us each), prepared in " << prepareMs << " ms ("
+                  << prepareMs * 1000.0 / numInstances << " us each)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include "../Interface/CurveEditor.h"
+
+/** OriotoLibraryBenchmark: builds a curve library of 10,000 entries in a
+    temporary file, then times opening it and the first listing of it in
+    the curve header's preset list, which is what someone opening the list
+    waits for. Fails if the library doesn't hold every entry; the timings
+    are only reported.
+*/
+namespace
+{
+constexpr int numEntries = 10000;
+constexpr int numNodes = 5;
+constexpr int numTags = 16;
+
+std::vector<PresetLibrary::Entry> createEntries()
+{
+    std::vector<PresetLibrary::Entry> entries;
+    juce::Random random (42);
+    auto handle = 2.0f / static_cast<float> (numNodes - 1) / 3.0f;
+    for (int i = 0; i < numEntries; i++)
+    {
+        juce::Array<Node> nodes;
+        for (int n = 0; n < numNodes; n++)
+        {
+            auto x = juce::jmap (static_cast<float> (n), 0.0f, static_cast<float> (numNodes - 1), -1.0f, 1.0f);
+            Node node;
+            node.endPoint = {x, random.nextFloat() * 2.0f - 1.0f};
+            node.controlPointOne = node.endPoint - juce::Point<float> (handle, 0.0f);
+            node.controlPointTwo = node.endPoint + juce::Point<float> (handle, 0.0f);
+            nodes.add (node);
+        }
+        juce::ValueTree curveBranch (id::CURVE);
+        CurveBranch::setNodes (curveBranch, nodes, nullptr);
+        // half are grouped into submenus by their tag
+        juce::StringArray tags;
+        if (i % 2 == 0)
+            tags.add ("Group " + juce::String (i % numTags + 1));
+        entries.push_back ({curveBranch, "Curve " + juce::String (i + 1), tags});
+    }
+    return entries;
+}
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::TemporaryFile temporary (".oriotolibrary");
+    auto file = temporary.getFile();
+
+    auto start = juce::Time::getMillisecondCounterHiRes();
+    if (PresetLibrary (file).addAll (createEntries()).size() != numEntries)
+    {
+        std::cout << "the library could not be written" << std::endl;
+        return 1;
+    }
+    auto buildMs = juce::Time::getMillisecondCounterHiRes() - start;
+
+    start = juce::Time::getMillisecondCounterHiRes();
+    PresetLibrary library (file);
+    auto openMs = juce::Time::getMillisecondCounterHiRes() - start;
+
+    auto state = DefaultTree::create();
+    juce::UndoManager undoManager;
+    oi::CurveHeader header (state.getChildWithName (id::CURVE), undoManager, library);
+    start = juce::Time::getMillisecondCounterHiRes();
+    header.listLibrary();
+    auto listMs = juce::Time::getMillisecondCounterHiRes() - start;
+
+    std::cout << numEntries << " entries, " << file.getSize() << " bytes, written in " << buildMs << " ms: opened in "
+              << openMs << " ms, listed in " << listMs << " ms (" << openMs + listMs << " ms together)" << std::endl;
+    return library.getNumEntries() == numEntries ? 0 : 1;
+}
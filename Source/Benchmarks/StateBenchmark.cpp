@@ -0,0 +1,96 @@
+#include <iostream>
+#include "../MainProcessor.h"
+#include "../DefaultTreeGenerator.h"
+#include "../ChebyshevCurve.h"
+#include "../StateFile.h"
+
+/** OriotoStateBenchmark: saves and loads a session's worth of plugin
+    states, 1, 100 and 1,000 instances, in the binary format and in the
+    binary XML written before it, which loads through StateFile's
+    fallback. Each state is a real processor's with 32 user presets of 65
+    nodes. Fails if the binary state doesn't load back equivalent to the
+    one saved, the XML one doesn't load back whole, or the binary one is
+    larger. The timings are only reported.
+*/
+namespace
+{
+constexpr int numUserPresets = 32;
+
+juce::ValueTree createState()
+{
+    MainProcessor processor;
+    auto state = processor.getState().createCopy();
+    auto presets = state.getChildWithName (id::CURVE).getChildWithName (id::PRESETS);
+    juce::Random random (42);
+    for (int i = 0; i < numUserPresets; i++)
+    {
+        ChebyshevCurve::Amplitudes amplitudes {};
+        for (auto& amplitude : amplitudes)
+            amplitude = random.nextFloat() * 0.4f - 0.2f;
+        juce::ValueTree preset (id::CURVE);
+        preset.setProperty (id::name, "User " + juce::String (i + 1), nullptr);
+        CurveBranch::setNodes (preset, ChebyshevCurve::fit (amplitudes), nullptr);
+        presets.addChild (preset, -1, nullptr);
+    }
+    return state;
+}
+
+struct Timing
+{
+    double saveMs = 0.0, loadMs = 0.0;
+    size_t numBytes = 0;
+    bool loadedAll = true, equivalent = true;
+};
+
+template <typename SaveFunction>
+Timing measure (const juce::ValueTree& state, int numInstances, SaveFunction save)
+{
+    Timing timing;
+    std::vector<juce::MemoryBlock> saved (static_cast<size_t> (numInstances));
+    auto start = juce::Time::getMillisecondCounterHiRes();
+    for (auto& block : saved)
+        save (state, block);
+    timing.saveMs = juce::Time::getMillisecondCounterHiRes() - start;
+    timing.numBytes = saved.front().getSize();
+
+    start = juce::Time::getMillisecondCounterHiRes();
+    for (const auto& block : saved)
+    {
+        auto loaded = StateFile::read (block.getData(), static_cast<int> (block.getSize()));
+        timing.loadedAll = timing.loadedAll && loaded.getNumChildren() == state.getNumChildren();
+        timing.equivalent = timing.equivalent && loaded.isEquivalentTo (state);
+    }
+    timing.loadMs = juce::Time::getMillisecondCounterHiRes() - start;
+    return timing;
+}
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    auto state = createState();
+
+    bool passed = true;
+    for (auto numInstances : {1, 100, 1000})
+    {
+        auto binary = measure (state, numInstances, [](const juce::ValueTree& tree, juce::MemoryBlock& block)
+            {
+                StateFile::write (tree, block);
+            });
+        auto xml = measure (state, numInstances, [](const juce::ValueTree& tree, juce::MemoryBlock& block)
+            {
+                std::unique_ptr<juce::XmlElement> element (tree.createXml());
+                juce::AudioProcessor::copyXmlToBinary (*element, block);
+            });
+
+        std::cout << numInstances << " instances:\n"
+                  << "  binary: " << binary.numBytes << " bytes each, saved in " << binary.saveMs
+                  << " ms, loaded in " << binary.loadMs << " ms\n"
+                  << "  XML:    " << xml.numBytes << " bytes each, saved in " << xml.saveMs
+                  << " ms, loaded in " << xml.loadMs << " ms" << std::endl;
+        // XML brings every property back as a string, so it only has to
+        // come back whole
+        passed = passed && binary.equivalent && xml.loadedAll && binary.numBytes <= xml.numBytes;
+    }
+    return passed ? 0 : 1;
+}
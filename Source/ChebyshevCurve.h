@@ -0,0 +1,90 @@
+#pragma once
+
+#include <juce_data_structures/juce_data_structures.h>
+#include "CurvePositionCalculator.h"
+
+/** Builds the transfer function x + a2 T2(x) + ... + a16 T16(x) from
+    Chebyshev polynomials of the first kind. Driven with a full scale sine,
+    Tk produces only harmonic k, so the amplitudes set the harmonic profile
+    directly (scaled together if the curve has to be normalized).
+*/
+struct ChebyshevCurve
+{
+    static constexpr int firstHarmonic = 2;
+    static constexpr int lastHarmonic = 16;
+    static constexpr int numHarmonics = lastHarmonic - firstHarmonic + 1;
+    // two nodes per extremum of the highest polynomial keep the Hermite fit tight
+    static constexpr int numNodes = 4 * lastHarmonic + 1;
+    using Amplitudes = std::array<float, numHarmonics>;
+
+    static juce::Identifier getHarmonicIdentifier (int harmonic)
+    {
+        jassert (harmonic >= firstHarmonic && harmonic <= lastHarmonic);
+        return juce::Identifier ("h" + juce::String (harmonic));
+    }
+    static Amplitudes getAmplitudes (const juce::ValueTree& harmonicsBranch)
+    {
+        Amplitudes amplitudes {};
+        for (int k = firstHarmonic; k <= lastHarmonic; k++)
+            amplitudes[static_cast<size_t> (k - firstHarmonic)] = harmonicsBranch.getProperty (getHarmonicIdentifier (k), 0.0f);
+        return amplitudes;
+    }
+
+    // Returns f(x) and writes f'(x) into slope, using Tk' = k U(k-1)
+    static float evaluate (const Amplitudes& amplitudes, float x, float& slope)
+    {
+        float value = x;
+        slope = 1.0f;
+
+        float tPrevious = 1.0f, t = x;
+        float uPrevious = 1.0f, u = 2.0f * x;
+        for (int k = 2; k <= lastHarmonic; k++)
+        {
+            auto tNext = 2.0f * x * t - tPrevious;
+            tPrevious = t; t = tNext;
+            // t is now Tk, u is still U(k-1)
+            auto amplitude = amplitudes[static_cast<size_t> (k - firstHarmonic)];
+            value += amplitude * t;
+            slope += amplitude * static_cast<float> (k) * u;
+
+            auto uNext = 2.0f * x * u - uPrevious;
+            uPrevious = u; u = uNext;
+        }
+        return value;
+    }
+
+    // Cubic Hermite fit on evenly spaced nodes. Each node's control points sit a
+    // third of the way to its neighbours along the tangent, which keeps them
+    // mirrored and makes x linear in the Bezier parameter, so the compiled curve
+    // matches the polynomial at every node in value and slope.
+    static juce::Array<Node> fit (const Amplitudes& amplitudes)
+    {
+        constexpr int numPeakPoints = 8 * (numNodes - 1) + 1;
+        float peak = 1.0f, slope = 0.0f;
+        for (int i = 0; i < numPeakPoints; i++)
+            peak = juce::jmax (peak, std::abs (evaluate (amplitudes, indexToX (i, numPeakPoints), slope)));
+        auto gain = 1.0f / peak;
+
+        auto handle = 2.0f / static_cast<float> (numNodes - 1) / 3.0f;
+        juce::Array<Node> nodes;
+        nodes.ensureStorageAllocated (numNodes);
+        for (int i = 0; i < numNodes; i++)
+        {
+            auto x = indexToX (i, numNodes);
+            auto y = evaluate (amplitudes, x, slope) * gain;
+            juce::Point<float> tangent (handle, handle * slope * gain);
+
+            Node node;
+            node.endPoint = {x, y};
+            node.controlPointOne = node.endPoint - tangent;
+            node.controlPointTwo = node.endPoint + tangent;
+            nodes.add (node);
+        }
+        return nodes;
+    }
+private:
+    static float indexToX (int index, int numPoints)
+    {
+        return juce::jmap (static_cast<float> (index), 0.0f, static_cast<float> (numPoints - 1), -1.0f, 1.0f);
+    }
+};
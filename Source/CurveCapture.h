@@ -0,0 +1,157 @@
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_dsp/juce_dsp.h>
+#include "CurveFit.h"
+
+/** Estimates the static transfer curve of a processor from a dry recording
+    and the same recording after processing, then fits it with as few
+    mirrored Bezier nodes as it can. Runs on its own thread, streaming both
+    files in blocks so memory stays fixed regardless of their length.
+*/
+class CurveCapture : private juce::Thread
+{
+public:
+    struct Result
+    {
+        juce::String name;
+        juce::String error;
+        juce::Array<Node> nodes;
+        juce::int64 delay = 0;
+        float rmsError = 0.0f;
+    };
+    // onComplete is called on the message thread
+    CurveCapture (juce::File dry, juce::File processed, std::function<void (const Result&)> onComplete)
+      : juce::Thread ("Orioto Curve Capture"),
+        dryFile (dry),
+        processedFile (processed),
+        completionCallback (std::move (onComplete))
+    {
+        formatManager.registerBasicFormats();
+        startThread();
+    }
+    ~CurveCapture() override
+    {
+        stopThread (10000);
+    }
+    float getProgress() const { return progress.load(); }
+private:
+    static constexpr int blockSize = 16384;
+    static constexpr int alignmentOrder = 17;
+    static constexpr int maxDelay = 16384;
+
+    juce::File dryFile, processedFile;
+    std::function<void (const Result&)> completionCallback;
+    juce::AudioFormatManager formatManager;
+    std::atomic<float> progress { 0.0f };
+
+    void run() override
+    {
+        Result result;
+        result.name = "Capture " + processedFile.getFileNameWithoutExtension();
+        result.error = capture (result);
+
+        if (threadShouldExit())
+            return;
+
+        juce::MessageManager::callAsync ([callback = completionCallback, result]() { callback (result); });
+    }
+    juce::String capture (Result& result)
+    {
+        std::unique_ptr<juce::AudioFormatReader> dryReader (formatManager.createReaderFor (dryFile));
+        std::unique_ptr<juce::AudioFormatReader> processedReader (formatManager.createReaderFor (processedFile));
+        if (dryReader == nullptr || processedReader == nullptr)
+            return "Could not read the selected files.";
+        if (! juce::approximatelyEqual (dryReader->sampleRate, processedReader->sampleRate))
+            return "The dry and processed files must have the same sample rate.";
+
+        result.delay = findDelay (*dryReader, *processedReader);
+        auto bins = std::make_unique<CurveFit::Bins>();
+        if (! accumulate (*dryReader, *processedReader, result.delay, *bins))
+            return threadShouldExit() ? juce::String() : "The dry file contains no signal.";
+
+        result.rmsError = static_cast<float> (CurveFit::fit (*bins, result.nodes, [this](float fitProgress)
+            {
+                progress = 0.9f + 0.1f * fitProgress;
+                return ! threadShouldExit();
+            }));
+        progress = 1.0f;
+        return {};
+    }
+
+    // Mono sum of both channels, zero padded past the end of the file
+    static void readMono (juce::AudioFormatReader& reader, juce::AudioBuffer<float>& buffer, juce::int64 start, int numSamples)
+    {
+        buffer.clear();
+        reader.read (&buffer, 0, numSamples, start, true, true);
+        if (reader.numChannels > 1)
+        {
+            buffer.addFrom (0, 0, buffer, 1, 0, numSamples);
+            buffer.applyGain (0, 0, numSamples, 0.5f);
+        }
+    }
+    // Lag of the processed file behind the dry one, from the peak of their
+    // cross-correlation over the opening of both files
+    juce::int64 findDelay (juce::AudioFormatReader& dryReader, juce::AudioFormatReader& processedReader)
+    {
+        constexpr int fftSize = 1 << alignmentOrder;
+        constexpr int numSamples = fftSize / 2;
+        juce::dsp::FFT fft (alignmentOrder);
+        std::vector<float> dry (2 * fftSize, 0.0f), processed (2 * fftSize, 0.0f);
+
+        juce::AudioBuffer<float> buffer (2, numSamples);
+        readMono (dryReader, buffer, 0, numSamples);
+        std::copy (buffer.getReadPointer (0), buffer.getReadPointer (0) + numSamples, dry.begin());
+        readMono (processedReader, buffer, 0, numSamples);
+        std::copy (buffer.getReadPointer (0), buffer.getReadPointer (0) + numSamples, processed.begin());
+
+        fft.performRealOnlyForwardTransform (dry.data());
+        fft.performRealOnlyForwardTransform (processed.data());
+        for (size_t i = 0; i < dry.size(); i += 2)
+        {
+            // conj (dry) * processed
+            auto re = dry[i] * processed[i] + dry[i + 1] * processed[i + 1];
+            auto im = dry[i] * processed[i + 1] - dry[i + 1] * processed[i];
+            dry[i] = re;
+            dry[i + 1] = im;
+        }
+        fft.performRealOnlyInverseTransform (dry.data());
+
+        int bestLag = 0;
+        float bestCorrelation = 0.0f;
+        for (int lag = -maxDelay; lag <= maxDelay; lag++)
+        {
+            auto correlation = std::abs (dry[static_cast<size_t> ((lag + fftSize) % fftSize)]);
+            if (correlation > bestCorrelation)
+            {
+                bestCorrelation = correlation;
+                bestLag = lag;
+            }
+        }
+        return bestLag;
+    }
+    // Streams both files into the fit's level bins
+    bool accumulate (juce::AudioFormatReader& dryReader, juce::AudioFormatReader& processedReader,
+                     juce::int64 delay, CurveFit::Bins& bins)
+    {
+        auto length = juce::jmin (dryReader.lengthInSamples, processedReader.lengthInSamples - delay);
+        juce::AudioBuffer<float> dry (2, blockSize), processed (2, blockSize);
+
+        for (juce::int64 start = juce::jmax (juce::int64 (0), -delay); start < length; start += blockSize)
+        {
+            if (threadShouldExit())
+                return false;
+
+            auto numSamples = static_cast<int> (juce::jmin (juce::int64 (blockSize), length - start));
+            readMono (dryReader, dry, start, numSamples);
+            readMono (processedReader, processed, start + delay, numSamples);
+
+            auto* x = dry.getReadPointer (0);
+            auto* y = processed.getReadPointer (0);
+            for (int i = 0; i < numSamples; i++)
+                bins.add (x[i], y[i]);
+            progress = static_cast<float> (0.9 * static_cast<double> (start) / static_cast<double> (length));
+        }
+        return bins.resolve();
+    }
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <juce_data_structures/juce_data_structures.h>
+#include "Identifiers.h"
+#include "DefaultTreeGenerator.h"
+#include "CurveFit.h"
+
+/** Reads and writes single curves outside the plugin state.
+    CSV files hold x,y samples of a transfer curve, fitted on import. Curve
+    files hold the nodes themselves, little-endian:
+
+        "ORCV", int32 version, string name, int32 numNodes, then per node
+        uint8 segment type, float32 x, y, and its control points relative
+        to it as float32 x1, y1, x2, y2
+*/
+struct CurveFile
+{
+    static constexpr const char* curveExtension = ".oriotocurve";
+    static constexpr const char* wildcard = "*.csv;*.oriotocurve";
+    static constexpr int numExportSamples = 1025;
+
+    // Fills a new CURVE branch from the file, without touching any listened-to
+    // tree. Returns an error message, or an empty string on success.
+    static juce::String read (const juce::File& file, juce::ValueTree& curveBranch)
+    {
+        curveBranch = juce::ValueTree (id::CURVE);
+        curveBranch.setProperty (id::name, file.getFileNameWithoutExtension(), nullptr);
+
+        if (file.hasFileExtension ("csv"))
+            return readSamples (file, curveBranch);
+        return readNodes (file, curveBranch);
+    }
+    // Writes the nodes of a CURVE or ACTIVE_CURVE branch, as sampled CSV or
+    // as nodes depending on the file's extension
+    static bool write (const juce::ValueTree& curveBranch, const juce::String& name, const juce::File& file)
+    {
+        juce::MemoryOutputStream stream;
+        if (file.hasFileExtension ("csv"))
+            writeSamples (curveBranch, stream);
+        else
+            writeNodes (curveBranch, name, stream);
+        return file.replaceWithData (stream.getData(), stream.getDataSize());
+    }
+private:
+    static constexpr int magic = ('O' << 0) | ('R' << 8) | ('C' << 16) | ('V' << 24);
+    static constexpr int version = 1;
+    static constexpr int bytesPerNode = 1 + 6 * 4;
+
+    static juce::String readSamples (const juce::File& file, juce::ValueTree& curveBranch)
+    {
+        juce::StringArray lines;
+        lines.addLines (file.loadFileAsString());
+
+        // anything that doesn't start like a number (headers, comments) is skipped
+        std::vector<juce::Point<float>> samples;
+        samples.reserve (static_cast<size_t> (lines.size()));
+        float peak = 0.0f;
+        for (auto& line : lines)
+        {
+            auto trimmed = line.trimStart();
+            auto first = trimmed[0];
+            if (! (juce::CharacterFunctions::isDigit (first) || first == '-' || first == '+' || first == '.'))
+                continue;
+            auto separator = trimmed.indexOfAnyOf (",;\t");
+            if (separator < 0)
+                continue;
+
+            juce::Point<float> sample (trimmed.substring (0, separator).getFloatValue(),
+                                       trimmed.substring (separator + 1).getFloatValue());
+            if (! std::isfinite (sample.x) || ! std::isfinite (sample.y))
+                continue;
+            peak = juce::jmax (peak, std::abs (sample.x));
+            samples.push_back (sample);
+        }
+        if (samples.size() < 2)
+            return "The file contains no x,y samples.";
+
+        // measurements in other units keep their shape, scaled to full input range
+        auto gain = peak > 1.0f ? 1.0f / peak : 1.0f;
+        auto bins = std::make_unique<CurveFit::Bins>();
+        for (const auto& sample : samples)
+            bins->add (sample.x * gain, sample.y * gain);
+        if (! bins->resolve())
+            return "The file contains no x,y samples.";
+
+        juce::Array<Node> nodes;
+        CurveFit::fit (*bins, nodes);
+        CurveBranch::setNodes (curveBranch, nodes, nullptr);
+        return {};
+    }
+    static juce::String readNodes (const juce::File& file, juce::ValueTree& curveBranch)
+    {
+        juce::MemoryBlock data;
+        if (! file.loadFileAsData (data))
+            return "Could not read the selected file.";
+
+        juce::MemoryInputStream stream (data, false);
+        if (stream.readInt() != magic || stream.readInt() > version)
+            return "The file is not an Orioto curve, or is from a newer version.";
+
+        auto name = stream.readString();
+        if (name.isNotEmpty())
+            curveBranch.setProperty (id::name, name, nullptr);
+
+        auto numNodes = stream.readInt();
+        if (numNodes < 2 || stream.getNumBytesRemaining() < static_cast<juce::int64> (numNodes) * bytesPerNode)
+            return "The curve file is damaged.";
+
+        auto previousX = -1.0f;
+        for (int i = 0; i < numNodes; i++)
+        {
+            auto type = static_cast<int> (stream.readByte());
+            std::array<float, 6> values {};
+            for (auto& value : values)
+                value = stream.readFloat();
+
+            if (type < 0 || type >= segmentTypeNames.size()
+                || ! std::all_of (values.begin(), values.end(), [](float v) { return std::isfinite (v); })
+                || values[0] < previousX || values[0] > 1.0f)
+                return "The curve file is damaged.";
+            previousX = values[0];
+
+            auto nodeBranch = NodeBranch::create ({values[0], values[1]}, {values[2], values[3]}, {values[4], values[5]});
+            if (type != static_cast<int> (SegmentType::bezier))
+                nodeBranch.setProperty (id::segmentType, type, nullptr);
+            curveBranch.addChild (nodeBranch, -1, nullptr);
+        }
+        return {};
+    }
+
+    static void writeSamples (const juce::ValueTree& curveBranch, juce::OutputStream& stream)
+    {
+        CurvePositionCalculator cpc (curveBranch);
+        if (cpc.getNodes().size() < 2)
+            return;
+
+        std::vector<float> samples (static_cast<size_t> (numExportSamples));
+        CurvePositionCalculator::renderTable (cpc.getNodes(), samples.data(), samples.size());
+        stream << "x,y" << juce::newLine;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            auto x = juce::jmap (static_cast<float> (i), 0.0f, static_cast<float> (numExportSamples - 1), -1.0f, 1.0f);
+            stream << juce::String (x, 6) << "," << juce::String (samples[i], 6) << juce::newLine;
+        }
+    }
+    static void writeNodes (const juce::ValueTree& curveBranch, const juce::String& name, juce::OutputStream& stream)
+    {
+        stream.writeInt (magic);
+        stream.writeInt (version);
+        stream.writeString (name);
+        stream.writeInt (curveBranch.getNumChildren());
+        for (const auto& nodeBranch : curveBranch)
+        {
+            stream.writeByte (static_cast<char> (static_cast<int> (nodeBranch.getProperty (id::segmentType, 0))));
+            for (auto type : {id::endPoint, id::controlPoint1, id::controlPoint2})
+            {
+                auto pointBranch = nodeBranch.getChildWithName (type);
+                stream.writeFloat (pointBranch.getProperty (id::x));
+                stream.writeFloat (pointBranch.getProperty (id::y));
+            }
+        }
+    }
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include "CurvePositionCalculator.h"
+
+/** Fits a curve with as few evenly spaced, mirrored Bezier nodes as it can,
+    from (input, output) samples gathered into level bins. Shared by curve
+    capture and CSV import.
+*/
+struct CurveFit
+{
+    static constexpr int numBins = 1024;
+    static constexpr size_t maxNumNodes = 20;
+    static constexpr double targetRmsError = 0.001;
+
+    // Conditional mean of the output for each input level
+    struct Bins
+    {
+        std::array<double, numBins> sum {};
+        std::array<double, numBins> count {};
+        std::array<double, numBins> target {};
+        std::array<double, numBins> weight {};
+        double total = 0.0;
+
+        void add (float x, float y)
+        {
+            auto bin = static_cast<size_t> (juce::jlimit (0, numBins - 1, static_cast<int> ((x + 1.0f) * 0.5f * numBins)));
+            sum[bin] += y;
+            count[bin] += 1.0;
+            total += 1.0;
+        }
+        // Turns the sums into fit targets. Empty bins hold the nearest measured
+        // level, weighted lightly so they only steer the fit where no sample
+        // reached. Returns false if there were no samples at all.
+        bool resolve()
+        {
+            if (std::none_of (count.begin(), count.end(), [](double c) { return c > 0.0; }))
+                return false;
+
+            auto emptyWeight = 0.01 * total / numBins;
+            for (size_t i = 0; i < numBins; i++)
+            {
+                if (count[i] > 0.0)
+                {
+                    target[i] = sum[i] / count[i];
+                    weight[i] = count[i];
+                    continue;
+                }
+                size_t left = i, right = i;
+                while (left > 0 && count[left] <= 0.0) left--;
+                while (right < numBins - 1 && count[right] <= 0.0) right++;
+                auto source = count[left] > 0.0 && (i - left <= right - i || count[right] <= 0.0) ? left : right;
+                target[i] = sum[source] / count[source];
+                weight[i] = emptyWeight;
+            }
+            return true;
+        }
+    };
+
+    // Weighted least squares for node heights and handle offsets, on evenly
+    // spaced nodes (uneven spacing would put kinks at the mirrored handles),
+    // adding nodes until the fit is good enough or the node budget is spent.
+    // shouldContinue, if given, is told the progress and can stop the fit early.
+    static double fit (const Bins& bins, juce::Array<Node>& nodes,
+                       const std::function<bool (float)>& shouldContinue = nullptr)
+    {
+        std::vector<double> positions, solution;
+        double rmsError = 0.0;
+        for (size_t numNodes = 3; numNodes <= maxNumNodes; numNodes++)
+        {
+            positions.resize (numNodes);
+            for (size_t i = 0; i < numNodes; i++)
+                positions[i] = -1.0 + 2.0 * static_cast<double> (i) / static_cast<double> (numNodes - 1);
+            solution = solve (bins, positions);
+
+            double squaredError = 0.0, totalWeight = 0.0;
+            for (size_t bin = 0; bin < numBins; bin++)
+            {
+                auto error = evaluate (positions, solution, binToX (bin)) - bins.target[bin];
+                squaredError += bins.weight[bin] * error * error;
+                totalWeight += bins.weight[bin];
+            }
+            rmsError = std::sqrt (squaredError / totalWeight);
+            if (rmsError < targetRmsError)
+                break;
+            if (shouldContinue != nullptr && ! shouldContinue (static_cast<float> (numNodes) / maxNumNodes))
+                break;
+        }
+
+        nodes.clearQuick();
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            auto leftGap = i > 0 ? positions[i] - positions[i - 1] : 2.0;
+            auto rightGap = i < positions.size() - 1 ? positions[i + 1] - positions[i] : 2.0;
+            juce::Point<float> handle (static_cast<float> (juce::jmin (leftGap, rightGap) / 3.0),
+                                       static_cast<float> (solution[2 * i + 1]));
+            Node node;
+            node.endPoint = {static_cast<float> (positions[i]),
+                             juce::jlimit (-1.0f, 1.0f, static_cast<float> (solution[2 * i]))};
+            node.controlPointOne = node.endPoint - handle;
+            node.controlPointTwo = node.endPoint + handle;
+            nodes.add (node);
+        }
+        return rmsError;
+    }
+private:
+    static double binToX (size_t bin)
+    {
+        return (static_cast<double> (bin) + 0.5) / numBins * 2.0 - 1.0;
+    }
+    // Bernstein weights of segment i's control values: y(i), y(i) + d(i), y(i+1) - d(i+1), y(i+1)
+    static std::array<double, 4> basis (const std::vector<double>& positions, double x, size_t& segment)
+    {
+        segment = static_cast<size_t> (std::upper_bound (positions.begin() + 1, positions.end() - 1, x) - positions.begin()) - 1;
+        auto t = (x - positions[segment]) / (positions[segment + 1] - positions[segment]);
+        auto s = 1.0 - t;
+        return {s * s * s, 3.0 * s * s * t, 3.0 * s * t * t, t * t * t};
+    }
+    static double evaluate (const std::vector<double>& positions, const std::vector<double>& solution, double x)
+    {
+        size_t i = 0;
+        auto b = basis (positions, x, i);
+        auto y0 = solution[2 * i], d0 = solution[2 * i + 1];
+        auto y1 = solution[2 * i + 2], d1 = solution[2 * i + 3];
+        return b[0] * y0 + b[1] * (y0 + d0) + b[2] * (y1 - d1) + b[3] * y1;
+    }
+    static std::vector<double> solve (const Bins& bins, const std::vector<double>& positions)
+    {
+        auto n = 2 * positions.size();
+        std::vector<double> matrix (n * n, 0.0), rhs (n, 0.0);
+        for (size_t bin = 0; bin < numBins; bin++)
+        {
+            size_t i = 0;
+            auto b = basis (positions, binToX (bin), i);
+            std::array<size_t, 4> columns { 2 * i, 2 * i + 1, 2 * i + 2, 2 * i + 3 };
+            std::array<double, 4> row { b[0] + b[1], b[1], b[2] + b[3], -b[2] };
+            for (size_t r = 0; r < 4; r++)
+            {
+                rhs[columns[r]] += bins.weight[bin] * row[r] * bins.target[bin];
+                for (size_t c = 0; c < 4; c++)
+                    matrix[columns[r] * n + columns[c]] += bins.weight[bin] * row[r] * row[c];
+            }
+        }
+        for (size_t i = 0; i < n; i++)
+            matrix[i * n + i] += 1.0e-9 * (1.0 + matrix[i * n + i]);
+
+        // Gaussian elimination with partial pivoting
+        for (size_t column = 0; column < n; column++)
+        {
+            auto pivot = column;
+            for (size_t r = column + 1; r < n; r++)
+                if (std::abs (matrix[r * n + column]) > std::abs (matrix[pivot * n + column]))
+                    pivot = r;
+            for (size_t c = 0; c < n; c++)
+                std::swap (matrix[column * n + c], matrix[pivot * n + c]);
+            std::swap (rhs[column], rhs[pivot]);
+
+            for (size_t r = column + 1; r < n; r++)
+            {
+                auto factor = matrix[r * n + column] / matrix[column * n + column];
+                for (size_t c = column; c < n; c++)
+                    matrix[r * n + c] -= factor * matrix[column * n + c];
+                rhs[r] -= factor * rhs[column];
+            }
+        }
+        std::vector<double> solution (n, 0.0);
+        for (size_t r = n; r-- > 0;)
+        {
+            auto value = rhs[r];
+            for (size_t c = r + 1; c < n; c++)
+                value -= matrix[r * n + c] * solution[c];
+            solution[r] = value / matrix[r * n + r];
+        }
+        return solution;
+    }
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include "CurvePositionCalculator.h"
+
+/** Whole-curve edits, each taking the nodes as stored in the tree and
+    returning the new ones, so the caller can write them back as a single
+    change. Normalizing and mirroring move the nodes themselves; resampling
+    and smoothing render the curve and fit new nodes to it.
+*/
+struct CurveOperations
+{
+    // Scales the curve vertically so its peak reaches full scale
+    static juce::Array<Node> normalize (const juce::Array<Node>& nodes)
+    {
+        auto table = render (nodes);
+        float peak = 0.0f;
+        for (auto value : table)
+            peak = juce::jmax (peak, std::abs (value));
+        if (peak < 1.0e-6f)
+            return nodes;
+
+        auto gain = 1.0f / peak;
+        auto result = nodes;
+        for (auto& node : result)
+        {
+            node.endPoint.y *= gain;
+            node.controlPointOne.y *= gain;
+            node.controlPointTwo.y *= gain;
+        }
+        return result;
+    }
+    // Keeps the right half and turns it about the origin onto the left, so
+    // f(-x) = -f(x) and the curve adds only odd harmonics
+    static juce::Array<Node> makeOddSymmetric (const juce::Array<Node>& nodes)
+    {
+        juce::Array<Node> right;
+        Node centre;
+        centre.type = SegmentType::catmullRom;
+        for (const auto& node : nodes)
+        {
+            if (std::abs (node.endPoint.x) < 1.0e-6f)
+                centre = node;
+            else if (node.endPoint.x > 0.0f)
+                right.add (node);
+        }
+        if (right.isEmpty())
+            return nodes;
+
+        // a node at the centre keeps its outgoing handle and type, and its
+        // incoming side mirrors them
+        auto handle = centre.controlPointTwo - centre.endPoint;
+        centre.endPoint = {};
+        centre.controlPointTwo = handle;
+        centre.controlPointOne = -handle;
+        right.insert (0, centre);
+
+        // the left half is turned from the right as compiled with the
+        // centre in place, each node's outgoing segment being the turned
+        // one that came in to it
+        auto compiled = compile (right);
+        juce::Array<Node> result;
+        result.ensureStorageAllocated (2 * right.size() - 1);
+        for (int i = compiled.size(); --i >= 1;)
+            result.add (reverse (compiled.getReference (i), compiled.getReference (i - 1).type == SegmentType::linear, {-1.0f, -1.0f}));
+        result.addArray (right);
+        return result;
+    }
+    // Swaps the curve left to right
+    static juce::Array<Node> mirrorHorizontally (const juce::Array<Node>& nodes)
+    {
+        auto compiled = compile (nodes);
+        juce::Array<Node> result;
+        result.ensureStorageAllocated (compiled.size());
+        for (int i = compiled.size(); --i >= 0;)
+            result.add (reverse (compiled.getReference (i), i > 0 && compiled.getReference (i - 1).type == SegmentType::linear, {-1.0f, 1.0f}));
+        return result;
+    }
+    // Turns the curve upside down
+    static juce::Array<Node> mirrorVertically (const juce::Array<Node>& nodes)
+    {
+        auto result = nodes;
+        for (auto& node : result)
+        {
+            node.endPoint.y = -node.endPoint.y;
+            node.controlPointOne.y = -node.controlPointOne.y;
+            node.controlPointTwo.y = -node.controlPointTwo.y;
+        }
+        return result;
+    }
+    // The same curve drawn through numNodes evenly spaced nodes
+    static juce::Array<Node> resample (const juce::Array<Node>& nodes, int numNodes)
+    {
+        jassert (numNodes > 1);
+        std::vector<float> positions (static_cast<size_t> (numNodes));
+        for (size_t i = 0; i < positions.size(); i++)
+            positions[i] = juce::jmap (static_cast<float> (i), 0.0f, static_cast<float> (numNodes - 1), -1.0f, 1.0f);
+        return fit (render (nodes), positions);
+    }
+    // Blurs the curve and fits it again through the same node positions,
+    // rounding off corners and shallow ripples
+    static juce::Array<Node> smooth (const juce::Array<Node>& nodes)
+    {
+        auto table = render (nodes);
+        // two box passes make a triangular kernel 1/32 of the range wide
+        blur (table, numPoints / 64);
+        blur (table, numPoints / 64);
+
+        std::vector<float> positions;
+        positions.reserve (static_cast<size_t> (nodes.size()));
+        for (const auto& node : nodes)
+            positions.push_back (node.endPoint.x);
+        return fit (table, positions);
+    }
+private:
+    static constexpr size_t numPoints = 4097;
+
+    // The nodes with every handle where the segment types put it
+    static juce::Array<Node> compile (const juce::Array<Node>& nodes)
+    {
+        auto compiled = nodes;
+        CurvePositionCalculator::resolveSegmentTypes (compiled);
+        return compiled;
+    }
+    // A compiled node scaled by (-1, ±1) into a reversed curve, where its
+    // handles swap sides. linear describes a node's outgoing segment, so it
+    // passes to the node that now starts the segment: a node whose
+    // incoming segment was straight becomes linear, and a linear node
+    // whose isn't keeps its corner as a hardKnee. A monotone, Catmull-Rom
+    // or Bezier node that has to start a straight segment can't be both,
+    // so it keeps its compiled handles as a Bezier node instead.
+    static Node reverse (const Node& node, bool incomingStraight, juce::Point<float> scale)
+    {
+        Node reversed;
+        reversed.endPoint = node.endPoint * scale;
+        reversed.controlPointOne = node.controlPointTwo * scale;
+        reversed.controlPointTwo = node.controlPointOne * scale;
+        if (incomingStraight)
+            reversed.type = node.type == SegmentType::linear || node.type == SegmentType::hardKnee ? SegmentType::linear
+                                                                                                   : SegmentType::bezier;
+        else
+            reversed.type = node.type == SegmentType::linear ? SegmentType::hardKnee : node.type;
+        return reversed;
+    }
+    static std::vector<float> render (const juce::Array<Node>& nodes)
+    {
+        jassert (nodes.size() > 1);
+        auto compiled = compile (nodes);
+        std::vector<float> table (numPoints);
+        CurvePositionCalculator::renderTable (compiled, table.data(), table.size());
+        return table;
+    }
+    static float sample (const std::vector<float>& table, float x)
+    {
+        auto index = juce::jmap (juce::jlimit (-1.0f, 1.0f, x), -1.0f, 1.0f, 0.0f, static_cast<float> (numPoints - 1));
+        auto i = juce::jmin (static_cast<size_t> (index), numPoints - 2);
+        auto fraction = index - static_cast<float> (i);
+        return table[i] + fraction * (table[i + 1] - table[i]);
+    }
+    // Running box filter of the given radius, holding the end values beyond
+    // the edges
+    static void blur (std::vector<float>& table, size_t radius)
+    {
+        auto source = table;
+        auto last = static_cast<long> (source.size()) - 1;
+        auto at = [&](long i) { return source[static_cast<size_t> (juce::jlimit (0L, last, i))]; };
+        auto r = static_cast<long> (radius);
+        float sum = 0.0f;
+        for (long i = -r; i <= r; i++)
+            sum += at (i);
+        for (long i = 0; i <= last; i++)
+        {
+            table[static_cast<size_t> (i)] = sum / static_cast<float> (2 * r + 1);
+            sum += at (i + r + 1) - at (i - r);
+        }
+    }
+    // Cubic Hermite fit through the given sorted positions, as in
+    // ChebyshevCurve: each node's handles sit a third of the way to its
+    // neighbours along the table's slope there. Where the positions are
+    // uneven the two handles differ in length; the editor keeps that
+    // ratio when one of them is dragged.
+    static juce::Array<Node> fit (const std::vector<float>& table, const std::vector<float>& positions)
+    {
+        const auto step = 2.0f / static_cast<float> (numPoints - 1);
+        juce::Array<Node> result;
+        result.ensureStorageAllocated (static_cast<int> (positions.size()));
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            auto x = positions[i];
+            auto left = juce::jmax (-1.0f, x - step), right = juce::jmin (1.0f, x + step);
+            auto slope = (sample (table, right) - sample (table, left)) / (right - left);
+            auto leftHandle = i > 0 ? (x - positions[i - 1]) / 3.0f : 0.0f;
+            auto rightHandle = i + 1 < positions.size() ? (positions[i + 1] - x) / 3.0f : 0.0f;
+            // the outer handles lead nowhere, and mirror the inner ones
+            if (i == 0)
+                leftHandle = rightHandle;
+            if (i + 1 == positions.size())
+                rightHandle = leftHandle;
+
+            Node node;
+            node.endPoint = {x, sample (table, x)};
+            node.controlPointOne = node.endPoint - juce::Point<float> (leftHandle, leftHandle * slope);
+            node.controlPointTwo = node.endPoint + juce::Point<float> (rightHandle, rightHandle * slope);
+            result.add (node);
+        }
+        return result;
+    }
+};
@@ -2,12 +2,67 @@
 
 #include <juce_data_structures/juce_data_structures.h>
 #include <juce_gui_basics/juce_gui_basics.h>
+#include "Identifiers.h"
+#include "FactoryCurves.h"
+
+// How the curve is shaped around a node. Everything but bezier ignores the 
+// node's stored control points and derives them when the curve is compiled.
+enum class SegmentType
+{
+    bezier = 0,  // the node's own mirrored control points
+    linear,      // a straight line to the next node
+    hardKnee,    // a corner, each side heading straight at its neighbour
+    monotone,    // Fritsch-Carlson tangent, never overshoots its neighbours
+    catmullRom   // tangent parallel to the chord between its neighbours
+};
+static const juce::StringArray segmentTypeNames {"Bezier", "Linear", "Hard Knee", "Monotone", "Catmull-Rom"};
 
 struct Node
 {
     juce::Point<float> endPoint;
     juce::Point<float> controlPointOne;
     juce::Point<float> controlPointTwo;
+    SegmentType type = SegmentType::bezier;
+
+    bool operator== (const Node& other) const
+    {
+        return type == other.type && endPoint == other.endPoint
+            && controlPointOne == other.controlPointOne && controlPointTwo == other.controlPointTwo;
+    }
+    bool operator!= (const Node& other) const { return ! operator== (other); }
+};
+// One compiled span between two nodes. x is linear in the Bezier parameter
+// over the span, so y is stored as a cubic in t = (x - start) / width and
+// evaluated with Horner's rule instead of de Casteljau.
+struct Segment
+{
+    float start = 0.0f;
+    float end = 0.0f;
+    float scale = 0.0f;  // 1 / width, or 0 for a vertical span
+    float a = 0.0f, b = 0.0f, c = 0.0f, d = 0.0f;
+
+    Segment() = default;
+    Segment (const Node& left, const Node& right)
+      : start (left.endPoint.x), end (right.endPoint.x)
+    {
+        auto p0 = left.endPoint.y;
+        a = p0;
+        if (juce::approximatelyEqual (start, end))
+            return;
+
+        auto p1 = left.controlPointTwo.y;
+        auto p2 = right.controlPointOne.y;
+        auto p3 = right.endPoint.y;
+        scale = 1.0f / (end - start);
+        b = 3.0f * (p1 - p0);
+        c = 3.0f * (p0 - 2.0f * p1 + p2);
+        d = p3 - p0 + 3.0f * (p1 - p2);
+    }
+    float evaluate (const float x) const
+    {
+        auto t = juce::jlimit (0.0f, 1.0f, (x - start) * scale);
+        return juce::jlimit (-1.0f, 1.0f, a + t * (b + t * (c + t * d)));
+    }
 };
 class CurvePositionCalculator
 {
@@ -15,26 +70,139 @@ public:
     CurvePositionCalculator (juce::ValueTree activeCurveBranch)
       : state (activeCurveBranch)
     {
-        jassert (state.getType() == id::ACTIVE_CURVE);
+        jassert (state.getType() == id::ACTIVE_CURVE || 
+                 state.getType() == id::CURVE);
         initializeState();
     }
-    float getYatX (const float x)
+    float getYatX (const float x) const
     {
-        return calculateYBetweenNodes (getLeftNode (x), getRightNode (x), x);
+        jassert (segments.size() > 0);
+        return segments.getReference (findRightNode (nodes, x) - 1).evaluate (x);
     }
-    void reset (juce::ValueTree curveBranch)
+    static float getYBetweenNodes (const Node& leftNode, const Node& rightNode, const float position)
     {
-        jassert (curveBranch.getType() == id::ACTIVE_CURVE);
-        state = curveBranch;
-        initializeState();
+        return Segment (leftNode, rightNode).evaluate (position);
     }
-private:
-    juce::ValueTree state;
-    juce::Array<Node> nodes;
+    const juce::Array<Node>& getNodes() const { return nodes; }
+    // Binary search for the node closing the segment that contains x, clamped
+    // to the outer segments. Nodes must be sorted by x.
+    static int findRightNode (const juce::Array<Node>& curveNodes, const float x)
+    {
+        jassert (curveNodes.size() > 1);
+        auto right = std::lower_bound (curveNodes.begin() + 1, curveNodes.end() - 1, x,
+                                       [](const Node& node, float value) { return node.endPoint.x < value; });
+        return static_cast<int> (right - curveNodes.begin());
+    }
+    // Fills numPoints evenly spaced values over [-1, 1], sweeping the nodes once
+    // and compiling each segment only when the sweep enters it
+    static void renderTable (const juce::Array<Node>& curveNodes, float* destination, size_t numPoints)
+    {
+        jassert (curveNodes.size() > 1 && numPoints > 1);
+        int right = 1;
+        Segment segment (curveNodes.getReference (0), curveNodes.getReference (1));
+        for (size_t i = 0; i < numPoints; i++)
+        {
+            auto x = juce::jmap (static_cast<float> (i), 0.0f, static_cast<float> (numPoints - 1), -1.0f, 1.0f);
+            if (x > segment.end && right < curveNodes.size() - 1)
+            {
+                while (right < curveNodes.size() - 1 && curveNodes.getReference (right).endPoint.x < x)
+                    right++;
+                segment = Segment (curveNodes.getReference (right - 1), curveNodes.getReference (right));
+            }
+            destination[i] = segment.evaluate (x);
+        }
+    }
+    // Replaces the control points of every node that isn't a bezier node with
+    // ones derived from its type and neighbours. Derived control points sit a
+    // third of the way along each segment, so x stays linear in the Bezier 
+    // parameter and drawing the nodes as cubics matches the compiled curve.
+    static void resolveSegmentTypes (juce::Array<Node>& curveNodes)
+    {
+        resolveSegmentTypes (curveNodes, {0, curveNodes.size()});
+    }
+    // As above, but only writes the nodes in the range (reading their
+    // neighbours), which is all that changes when one node moves
+    static void resolveSegmentTypes (juce::Array<Node>& curveNodes, juce::Range<int> range)
+    {
+        resolveSegmentTypes (curveNodes.getRawDataPointer(), curveNodes.size(), range);
+    }
+    // As above, over a plain run of nodes, such as the audio thread's
+    // fixed-size scratch array
+    static void resolveSegmentTypes (Node* curveNodes, int numNodes, juce::Range<int> range)
+    {
+        auto slope = [&](int left)
+            {
+                const auto& a = curveNodes[left].endPoint;
+                const auto& b = curveNodes[left + 1].endPoint;
+                return b.x - a.x > 0.0f ? (b.y - a.y) / (b.x - a.x) : 0.0f;
+            };
+        // tangent of node i on its left (incoming) or right (outgoing) side
+        auto tangent = [&](int i, bool outgoing)
+            {
+                auto type = curveNodes[i].type;
+                auto left = i > 0 ? slope (i - 1) : slope (i);
+                auto right = i < numNodes - 1 ? slope (i) : slope (i - 1);
+                switch (type)
+                {
+                    case SegmentType::catmullRom:
+                    {
+                        if (i == 0 || i == numNodes - 1)
+                            return outgoing ? right : left;
+                        const auto& a = curveNodes[i - 1].endPoint;
+                        const auto& b = curveNodes[i + 1].endPoint;
+                        return b.x - a.x > 0.0f ? (b.y - a.y) / (b.x - a.x) : 0.0f;
+                    }
+                    case SegmentType::monotone:
+                    {
+                        if (i == 0 || i == numNodes - 1)
+                            return outgoing ? right : left;
+                        if (left * right <= 0.0f)
+                            return 0.0f;
+                        // weighted harmonic mean keeps |m| within 3x both secants
+                        auto h0 = curveNodes[i].endPoint.x - curveNodes[i - 1].endPoint.x;
+                        auto h1 = curveNodes[i + 1].endPoint.x - curveNodes[i].endPoint.x;
+                        return 3.0f * (h0 + h1) / ((2.0f * h1 + h0) / left + (h1 + 2.0f * h0) / right);
+                    }
+                    case SegmentType::bezier:
+                    case SegmentType::linear:
+                    case SegmentType::hardKnee:
+                        break;
+                }
+                return outgoing ? right : left;
+            };
 
-    Node nodeFromIndex (int index)
+        for (int i = juce::jmax (0, range.getStart() - 1); i < juce::jmin (numNodes - 1, range.getEnd()); i++)
+        {
+            auto& node = curveNodes[i];
+            auto& next = curveNodes[i + 1];
+            auto third = (next.endPoint.x - node.endPoint.x) / 3.0f;
+            auto straight = node.type == SegmentType::linear;
+
+            if (node.type != SegmentType::bezier && range.contains (i))
+            {
+                auto m = straight ? slope (i) : tangent (i, true);
+                node.controlPointTwo = {node.endPoint.x + third, node.endPoint.y + m * third};
+            }
+            if ((next.type != SegmentType::bezier || straight) && range.contains (i + 1))
+            {
+                auto m = straight ? slope (i) : tangent (i + 1, false);
+                next.controlPointOne = {next.endPoint.x - third, next.endPoint.y - m * third};
+            }
+        }
+        // the outer handles lead nowhere, keep them tidy
+        if (numNodes > 1)
+        {
+            auto& first = curveNodes[0];
+            if (first.type != SegmentType::bezier && range.contains (0))
+                first.controlPointOne = first.endPoint * 2.0f - first.controlPointTwo;
+            auto& last = curveNodes[numNodes - 1];
+            if (last.type != SegmentType::bezier && range.contains (numNodes - 1))
+                last.controlPointTwo = last.endPoint * 2.0f - last.controlPointOne;
+        }
+    }
+    // The node stored in a NODE branch, with its control points made absolute
+    static Node readNode (const juce::ValueTree& nodeBranch)
     {
-        auto nodeBranch = state.getChild (index);
         Node node;
         auto endPoint = nodeBranch.getChildWithName (id::endPoint);
         node.endPoint = {static_cast<float> (endPoint.getProperty (id::x)), 
@@ -45,62 +213,102 @@ private:
         auto controlPointTwo = nodeBranch.getChildWithName (id::controlPoint2);
         node.controlPointTwo = {node.endPoint.x + static_cast<float> (controlPointTwo.getProperty (id::x)), 
                                 node.endPoint.y + static_cast<float> (controlPointTwo.getProperty (id::y))};
+        node.type = static_cast<SegmentType> (static_cast<int> (nodeBranch.getProperty (id::segmentType, 0)));
         return node;
     }
-    void initializeState()
+    // Every node of a CURVE or ACTIVE_CURVE branch, as readNode gives them,
+    // or those of the factory curve it refers to
+    static juce::Array<Node> readNodes (const juce::ValueTree& curveBranch)
     {
-        nodes.clear();
-        for (int i = 0; i < state.getNumChildren(); i++)
-            nodes.add (nodeFromIndex (i));
+        if (isFactoryReference (curveBranch))
+            return readFactoryNodes (curveBranch.getProperty (id::factoryCurve));
+
+        juce::Array<Node> curveNodes;
+        curveNodes.ensureStorageAllocated (curveBranch.getNumChildren());
+        for (const auto& nodeBranch : curveBranch)
+            curveNodes.add (readNode (nodeBranch));
+        return curveNodes;
     }
-    inline float lerp (const float a, const float b, const float position)
+    static juce::Array<Node> readFactoryNodes (int index)
     {
-        jassert (position >= 0.0f && position <= 1.0f);
-        return ((1.0f - position) * a) + (b * position);
+        jassert (juce::isPositiveAndBelow (index, FactoryCurves::numCurves));
+        const auto& curve = FactoryCurves::get (juce::jlimit (0, FactoryCurves::numCurves - 1, index));
+        juce::Array<Node> curveNodes;
+        curveNodes.ensureStorageAllocated (curve.numNodes);
+        for (int i = 0; i < curve.numNodes; i++)
+        {
+            const auto& data = curve.nodes[i];
+            Node node;
+            node.endPoint = {data.x, data.y};
+            node.controlPointOne = {data.x + data.x1, data.y + data.y1};
+            node.controlPointTwo = {data.x + data.x2, data.y + data.y2};
+            node.type = static_cast<SegmentType> (data.type);
+            curveNodes.add (node);
+        }
+        return curveNodes;
     }
-    inline juce::Point<float> lerp (const juce::Point<float> a, const juce::Point<float> b, const float position)
+    // A preset that hasn't been given nodes of its own
+    static bool isFactoryReference (const juce::ValueTree& curveBranch)
     {
-        jassert (position >= 0.0f && position <= 1.0f);
-        return {lerp (a.x, b.x, position), lerp (a.y, b.y, position)};
+        return curveBranch.getNumChildren() == 0 && curveBranch.hasProperty (id::factoryCurve);
     }
-
-    const Node* getLeftNode (float x)
+    // 64-bit FNV-1a over each node's type and coordinates, so identical
+    // curves can be recognised wherever they are stored
+    static juce::int64 hashNodes (const juce::Array<Node>& curveNodes)
     {
-        for (int i = 1; i < nodes.size(); i++)
-            if (nodes[i].endPoint.getX() >= x)
-                return &nodes.getReference (i - 1);
-
-        jassertfalse;
-        return nullptr;
+        juce::uint64 hash = 0xcbf29ce484222325;
+        auto add = [&hash](juce::uint32 word)
+            {
+                for (int shift = 0; shift < 32; shift += 8)
+                {
+                    hash ^= (word >> shift) & 0xff;
+                    hash *= 0x100000001b3;
+                }
+            };
+        for (const auto& node : curveNodes)
+        {
+            add (static_cast<juce::uint32> (node.type));
+            for (auto value : {node.endPoint.x, node.endPoint.y,
+                               node.controlPointOne.x, node.controlPointOne.y,
+                               node.controlPointTwo.x, node.controlPointTwo.y})
+            {
+                juce::uint32 bits;
+                std::memcpy (&bits, &value, sizeof (bits));
+                add (bits);
+            }
+        }
+        return static_cast<juce::int64> (hash);
     }
-    const Node* getRightNode (float x)
+    void reset (juce::ValueTree curveBranch)
     {
-        for (int i = 0; i < nodes.size(); i++)
-            if (nodes[i].endPoint.getX() >= x)
-                return &nodes.getReference (i);
-
-        jassertfalse;
-        return nullptr;
+        jassert (curveBranch.getType() == id::ACTIVE_CURVE);
+        state = curveBranch;
+        initializeState();
     }
-    float calculateYBetweenNodes (const Node* leftNode, const Node* rightNode, const float position)
-    {
-        // jassert (position >= leftNode->endPoint.getX() &&
-        //          position <= rightNode->endPoint.getX());
-
-        if (juce::approximatelyEqual (leftNode->endPoint.getX(), rightNode->endPoint.getX()))
-            return leftNode->endPoint.getY();
+private:
+    juce::ValueTree state;
+    juce::Array<Node> nodes;
+    juce::Array<Segment> segments;
 
-        float normalizedPosition = juce::jmap (position, 
-                                               leftNode->endPoint.getX(), 
-                                               rightNode->endPoint.getX(), 
-                                               0.0f, 1.0f);
+    void initializeState()
+    {
+        if (isFactoryReference (state))
+        {
+            nodes = readFactoryNodes (state.getProperty (id::factoryCurve));
+        }
+        else
+        {
+            nodes.clearQuick();
+            nodes.ensureStorageAllocated (state.getNumChildren());
+            for (const auto& nodeBranch : state)
+                nodes.add (readNode (nodeBranch));
+        }
+        auto numNodes = nodes.size();
+        resolveSegmentTypes (nodes);
 
-        auto a = lerp (leftNode->endPoint, leftNode->controlPointTwo, normalizedPosition);
-        auto b = lerp (leftNode->controlPointTwo, rightNode->controlPointOne, normalizedPosition);
-        auto c = lerp (rightNode->controlPointOne, rightNode->endPoint, normalizedPosition);
-        auto d = lerp (a, b, normalizedPosition);
-        auto e = lerp (b, c, normalizedPosition);
-        auto f = lerp (d, e, normalizedPosition);
-        return juce::jlimit (-1.0f, 1.0f, f.getY());
+        segments.clearQuick();
+        segments.ensureStorageAllocated (juce::jmax (0, numNodes - 1));
+        for (int i = 1; i < numNodes; i++)
+            segments.add (Segment (nodes.getReference (i - 1), nodes.getReference (i)));
     }
 };
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+namespace op
+{
+/** One worker thread shared by every instance, for rebuilding tables off
+    the message and audio threads. Hold it through a 
+    juce::SharedResourcePointer<BackgroundBuilder>.
+*/
+class BackgroundBuilder : private juce::Thread
+{
+public:
+    struct Task
+    {
+        virtual ~Task() = default;
+        virtual void run() = 0;
+    };
+
+    BackgroundBuilder()
+      : juce::Thread ("Orioto Background Builder")
+    {
+        startThread();
+    }
+    ~BackgroundBuilder() override
+    {
+        stopThread (4000);
+    }
+    // Queues the task unless it is already waiting to run
+    void schedule (Task* task)
+    {
+        {
+            const juce::ScopedLock sl (queueLock);
+            queue.addIfNotAlreadyThere (task);
+        }
+        notify();
+    }
+    // Removes the task, blocking until it has stopped if it is running
+    void cancel (Task* task)
+    {
+        {
+            const juce::ScopedLock sl (queueLock);
+            queue.removeFirstMatchingValue (task);
+        }
+        const juce::ScopedLock sl (runLock);
+    }
+    // Blocks until every queued task has run, for offline use where the
+    // results are needed before processing starts
+    void waitUntilIdle()
+    {
+        for (;;)
+        {
+            {
+                const juce::ScopedLock rl (runLock);
+                const juce::ScopedLock ql (queueLock);
+                if (queue.isEmpty())
+                    return;
+            }
+            notify();
+            juce::Thread::sleep (1);
+        }
+    }
+private:
+    juce::CriticalSection queueLock, runLock;
+    juce::Array<Task*> queue;
+
+    Task* popTask()
+    {
+        const juce::ScopedLock sl (queueLock);
+        return queue.isEmpty() ? nullptr : queue.removeAndReturn (0);
+    }
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            {
+                const juce::ScopedLock sl (runLock);
+                if (auto* task = popTask())
+                {
+                    task->run();
+                    continue;
+                }
+            }
+            wait (-1);
+        }
+    }
+};
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <juce_data_structures/juce_data_structures.h>
+#include "../Identifiers.h"
+#include "../CurvePositionCalculator.h"
+#include "TripleBuffer.h"
+#include "BackgroundBuilder.h"
+
+namespace op
+{
+/** Every preset (or those flagged inScan, if any are) rendered into one
+    contiguous table of curves by input, so a scan position can morph
+    between neighbouring curves per sample. Built on the shared
+    BackgroundBuilder once prepared, and rebuilt whenever the presets
+    change after that, so instances that are never played render nothing.
+*/
+class CurveBank : private juce::ValueTree::Listener,
+                  private BackgroundBuilder::Task
+{
+public:
+    static constexpr int maxNumCurves = 64;
+    static constexpr size_t numPoints = 2048;
+
+    CurveBank (juce::ValueTree presetsBranch)
+      : state (presetsBranch)
+    {
+        jassert (state.getType() == id::PRESETS);
+        state.addListener (this);
+    }
+    ~CurveBank() override
+    {
+        state.removeListener (this);
+        builder->cancel (this);
+    }
+
+    // Schedules the first build. Called from prepareToPlay, on a thread the
+    // presets aren't being edited from.
+    void prepare()
+    {
+        if (prepared)
+            return;
+        prepared = true;
+        gatherCurves();
+    }
+    // Audio thread. Picks up a newly built bank, if there is one.
+    void update() { banks.acquire(); }
+    bool isEmpty() const { return banks.getReadBuffer().numCurves == 0; }
+
+    // Audio thread. scanPosition runs from the first curve at 0 to the last at 1.
+    float lookUp (const float value, const float scanPosition) const
+    {
+        const auto& bank = banks.getReadBuffer();
+        jassert (bank.numCurves > 0);
+
+        auto curvePosition = juce::jlimit (0.0f, 1.0f, scanPosition) * static_cast<float> (bank.numCurves - 1);
+        auto curve = juce::jmin (static_cast<size_t> (curvePosition), bank.numCurves - 1);
+        auto curveFraction = curvePosition - static_cast<float> (curve);
+
+        auto index = juce::jmap (juce::jlimit (-1.0f, 1.0f, value), -1.0f, 1.0f, 0.0f, static_cast<float> (numPoints - 1));
+        auto i = static_cast<size_t> (index);
+        auto fraction = index - static_cast<float> (i);
+
+        const auto* lower = bank.table.data() + curve * rowSize + i;
+        const auto* upper = curve + 1 < bank.numCurves ? lower + rowSize : lower;
+        auto a = lower[0] + fraction * (lower[1] - lower[0]);
+        auto b = upper[0] + fraction * (upper[1] - upper[0]);
+        return a + curveFraction * (b - a);
+    }
+private:
+    static constexpr size_t rowSize = numPoints + 1;
+
+    struct Bank
+    {
+        std::vector<float> table;
+        size_t numCurves = 0;
+    };
+    TripleBuffer<Bank> banks;
+
+    juce::ValueTree state;
+    juce::SharedResourcePointer<BackgroundBuilder> builder;
+    juce::CriticalSection sourceLock;
+    juce::Array<juce::Array<Node>> sourceCurves;
+    bool prepared = false;
+
+    void gatherCurves()
+    {
+        if (! prepared)
+            return;
+
+        bool subset = false;
+        for (int i = 0; i < state.getNumChildren(); i++)
+            subset = subset || static_cast<bool> (state.getChild (i).getProperty (id::inScan, false));
+
+        juce::Array<juce::Array<Node>> curves;
+        for (int i = 0; i < state.getNumChildren() && curves.size() < maxNumCurves; i++)
+        {
+            auto curveBranch = state.getChild (i);
+            if (subset && ! static_cast<bool> (curveBranch.getProperty (id::inScan, false)))
+                continue;
+
+            CurvePositionCalculator cpc (curveBranch);
+            if (cpc.getNodes().size() > 1)
+                curves.add (cpc.getNodes());
+        }
+
+        {
+            const juce::ScopedLock sl (sourceLock);
+            sourceCurves.swapWith (curves);
+        }
+        builder->schedule (this);
+    }
+    // BackgroundBuilder thread, the only writer of banks
+    void run() override
+    {
+        juce::Array<juce::Array<Node>> curves;
+        {
+            const juce::ScopedLock sl (sourceLock);
+            curves = sourceCurves;
+        }
+
+        auto& bank = banks.getWriteBuffer();
+        bank.numCurves = static_cast<size_t> (curves.size());
+        bank.table.resize (bank.numCurves * rowSize);
+        for (size_t curve = 0; curve < bank.numCurves; curve++)
+        {
+            auto* row = bank.table.data() + curve * rowSize;
+            CurvePositionCalculator::renderTable (curves.getReference (static_cast<int> (curve)), row, numPoints);
+            row[numPoints] = row[numPoints - 1];
+        }
+        banks.publish();
+    }
+
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override
+    {
+        juce::ignoreUnused (tree, property);
+        gatherCurves();
+    }
+    void valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree& child) override
+    {
+        juce::ignoreUnused (parent, child);
+        gatherCurves();
+    }
+    void valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree& child, int index) override
+    {
+        juce::ignoreUnused (parent, child, index);
+        gatherCurves();
+    }
+    void valueTreeChildOrderChanged (juce::ValueTree& parent, int oldIndex, int newIndex) override
+    {
+        juce::ignoreUnused (parent, oldIndex, newIndex);
+        gatherCurves();
+    }
+};
+}
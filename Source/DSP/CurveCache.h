@@ -0,0 +1,67 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include "../CurvePositionCalculator.h"
+#include <map>
+
+namespace op
+{
+/** Compiled curve tables shared by every instance in the process, so fifty
+    instances on the same curve hold one table between them and only the
+    first builds it. Tables are immutable once built and are looked up by a
+    hash of the nodes and the table size. Hold it through a
+    juce::SharedResourcePointer<CurveCache>.
+
+    The cache only keeps weak references; a table lives as long as some
+    instance holds it. Instances hand tables to the audio thread through a
+    TripleBuffer, whose slots are only ever overwritten by the writer, so
+    the last reference is always dropped off the audio thread and the audio
+    thread never touches the cache.
+*/
+class CurveCache
+{
+public:
+    using Table = std::vector<float>;
+
+    // The table for the nodes, numPoints values over [-1, 1] plus a guard
+    // point repeating the last, built now if no instance holds it yet
+    std::shared_ptr<const Table> get (const juce::Array<Node>& nodes, size_t numPoints)
+    {
+        jassert (nodes.size() > 1 && numPoints > 1);
+        const Key key { CurvePositionCalculator::hashNodes (nodes), numPoints };
+
+        const juce::ScopedLock sl (lock);
+        // the nodes are compared too, so a collision costs a rebuild
+        // instead of the wrong curve
+        auto range = entries.equal_range (key);
+        for (auto it = range.first; it != range.second; ++it)
+            if (auto table = it->second.table.lock())
+                if (it->second.nodes == nodes)
+                    return table;
+
+        auto table = std::make_shared<Table> (numPoints + 1);
+        CurvePositionCalculator::renderTable (nodes, table->data(), numPoints);
+        (*table)[numPoints] = (*table)[numPoints - 1];
+
+        removeExpired();
+        entries.emplace (key, Entry { nodes, table });
+        return table;
+    }
+private:
+    using Key = std::pair<juce::int64, size_t>;
+    struct Entry
+    {
+        juce::Array<Node> nodes;
+        std::weak_ptr<const Table> table;
+    };
+
+    juce::CriticalSection lock;
+    std::multimap<Key, Entry> entries;
+
+    void removeExpired()
+    {
+        for (auto it = entries.begin(); it != entries.end();)
+            it = it->second.table.expired() ? entries.erase (it) : std::next (it);
+    }
+};
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+namespace op
+{
+/** Peak and RMS of the audio at one point in the chain, and for one after
+    a compressor the gain reduction across it. The audio thread measures
+    each block; the interface reads the results through atomics.
+*/
+class LevelMeter
+{
+public:
+    // Audio thread
+    void measure (const juce::dsp::AudioBlock<float>& block) noexcept
+    {
+        auto numSamples = static_cast<int> (block.getNumSamples());
+        if (numSamples == 0)
+            return;
+
+        float blockPeak = 0.0f;
+        float sumOfSquares = 0.0f;
+        for (size_t channel = 0; channel < block.getNumChannels(); channel++)
+        {
+            const auto* samples = block.getChannelPointer (channel);
+            auto range = juce::FloatVectorOperations::findMinAndMax (samples, numSamples);
+            blockPeak = juce::jmax (blockPeak, -range.getStart(), range.getEnd());
+            sumOfSquares = std::inner_product (samples, samples + numSamples, samples, sumOfSquares);
+        }
+
+        // held until the interface takes it, so short peaks between frames still show
+        if (blockPeak > peak.load (std::memory_order_relaxed))
+            peak.store (blockPeak, std::memory_order_relaxed);
+        meanSquare.store (sumOfSquares / static_cast<float> (block.getNumChannels() * block.getNumSamples()),
+                          std::memory_order_relaxed);
+    }
+    // Audio thread, after measure(). The level lost since the given meter,
+    // which measured the same block before a compressor (which adds no
+    // makeup gain), in decibels at or below 0. Worked out here from the one
+    // block so the interface never pairs levels from different blocks.
+    void measureGainReduction (const LevelMeter& before) noexcept
+    {
+        auto in = juce::Decibels::gainToDecibels (before.getRms(), silenceDecibels);
+        auto out = juce::Decibels::gainToDecibels (getRms(), silenceDecibels);
+        gainReduction.store (in <= silenceDecibels ? 0.0f : juce::jmin (0.0f, out - in), std::memory_order_relaxed);
+    }
+    // Message thread. The highest peak since the last call, as gain.
+    float takePeak() { return peak.exchange (0.0f, std::memory_order_relaxed); }
+    // RMS of the latest block, as gain
+    float getRms() const { return std::sqrt (meanSquare.load (std::memory_order_relaxed)); }
+    // Measured from RMS, so it follows the compressor's envelope rather
+    // than its per-sample gain
+    float getGainReduction() const { return gainReduction.load (std::memory_order_relaxed); }
+
+    static constexpr float silenceDecibels = -80.0f;
+private:
+    std::atomic<float> peak { 0.0f };
+    std::atomic<float> meanSquare { 0.0f };
+    std::atomic<float> gainReduction { 0.0f };
+};
+
+/** A ProcessorChain stage that measures what reaches it into a LevelMeter,
+    leaving the audio as it is. Given the meter of an earlier stage, it
+    also measures the gain reduction since then.
+*/
+class MeterStage
+{
+public:
+    void setMeter (LevelMeter& newMeter, const LevelMeter* gainReductionReference = nullptr)
+    {
+        meter = &newMeter;
+        reference = gainReductionReference;
+    }
+
+    void prepare (const juce::dsp::ProcessSpec& spec) noexcept { juce::ignoreUnused (spec); }
+    void reset() noexcept {}
+    template <typename ProcessContext>
+    void process (const ProcessContext& context) noexcept
+    {
+        if (meter == nullptr || context.isBypassed)
+            return;
+        meter->measure (context.getOutputBlock());
+        if (reference != nullptr)
+            meter->measureGainReduction (*reference);
+    }
+private:
+    LevelMeter* meter = nullptr;
+    const LevelMeter* reference = nullptr;
+};
+
+// Every metered point in the processor, in the order the audio meets them
+struct Meters
+{
+    static constexpr float silenceDecibels = LevelMeter::silenceDecibels;
+
+    LevelMeter input;
+    LevelMeter inputCompressorIn, inputCompressorOut;
+    LevelMeter outputCompressorIn, outputCompressorOut;
+    LevelMeter output;
+};
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+namespace op
+{
+/** Passes pairs of input and output samples, decimated to at most a given
+    rate, from the audio thread to a single reader through a wait-free FIFO.
+    Nothing is pushed unless a reader is attached, and points that don't fit
+    are dropped.
+*/
+class SignalTap
+{
+public:
+    static constexpr int capacity = 16384;
+    static constexpr double pointsPerSecond = 12000.0;
+
+    SignalTap()
+    {
+        points.resize (static_cast<size_t> (capacity));
+    }
+    // sampleRate is the rate push() is called at
+    void prepare (double sampleRate, double maxPointsPerSecond = pointsPerSecond)
+    {
+        decimation = juce::jmax (1, juce::roundToInt (sampleRate / maxPointsPerSecond));
+        countdown = 0;
+        pointRate = sampleRate / decimation;
+    }
+    // Rate of the points that come out, for the reader
+    double getPointRate() const { return pointRate.load (std::memory_order_relaxed); }
+
+    void attach() { numReaders++; }
+    void detach() { numReaders--; }
+    bool isActive() const { return numReaders.load (std::memory_order_relaxed) > 0; }
+
+    // Audio thread, only while isActive()
+    void push (float input, float output)
+    {
+        if (--countdown > 0)
+            return;
+        countdown = decimation;
+
+        const auto scope = fifo.write (1);
+        if (scope.blockSize1 > 0)
+            points[static_cast<size_t> (scope.startIndex1)] = {input, output};
+    }
+    // Reader thread. Moves up to maxNumPoints of the oldest points into
+    // destination, returning how many there were.
+    int pop (juce::Point<float>* destination, int maxNumPoints)
+    {
+        const auto scope = fifo.read (juce::jmin (maxNumPoints, fifo.getNumReady()));
+        std::copy_n (points.begin() + scope.startIndex1, scope.blockSize1, destination);
+        std::copy_n (points.begin() + scope.startIndex2, scope.blockSize2, destination + scope.blockSize1);
+        return scope.blockSize1 + scope.blockSize2;
+    }
+private:
+    juce::AbstractFifo fifo { capacity };
+    std::vector<juce::Point<float>> points;
+    std::atomic<int> numReaders { 0 };
+    std::atomic<double> pointRate { 44100.0 };
+
+    // audio thread state
+    int decimation = 1;
+    int countdown = 0;
+};
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+// Set by the ORIOTO_PROFILING CMake option. When 0 the profiler isn't built
+// and the macros below expand to nothing.
+#ifndef ORIOTO_PROFILING
+ #define ORIOTO_PROFILING 0
+#endif
+
+namespace op
+{
+/** Times each stage of processBlock with the cycle counter, into lock-free
+    histograms the interface can read while audio runs. Each histogram has
+    four buckets per octave, so reported percentiles are within 13% of the
+    true values.
+*/
+class StageProfiler
+{
+public:
+    enum Stage { inputChain, upsampling, shaping, downsampling, outputChain, numStages };
+    static constexpr std::array<const char*, numStages> stageNames { "Input Chain", "Upsampling", "Shaping",
+                                                                       "Downsampling", "Output Chain" };
+    struct Summary
+    {
+        double p50 = 0.0, p99 = 0.0, max = 0.0;
+    };
+    struct Report
+    {
+        std::array<Summary, numStages> stages; // microseconds
+        Summary load;                          // percent of the block's duration
+        juce::uint64 numBlocks = 0;
+    };
+
+    // Audio setup thread
+    void prepare (double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        calibrationCycles = readCycles();
+        calibrationTicks = juce::Time::getHighResolutionTicks();
+    }
+
+    // Audio thread
+    void beginBlock()
+    {
+        if (resetRequested.exchange (false, std::memory_order_relaxed))
+        {
+            for (auto& histogram : histograms)
+                histogram.clear();
+            loadHistogram.clear();
+        }
+        blockStart = readCycles();
+    }
+    void start() { stageStart = readCycles(); }
+    void stop (Stage stage) { histograms[static_cast<size_t> (stage)].add (readCycles() - stageStart); }
+    void endBlock (int numSamples)
+    {
+        auto cycles = static_cast<double> (readCycles() - blockStart);
+        auto deadline = static_cast<double> (numSamples) / sampleRate * getCyclesPerSecond();
+        if (deadline > 0.0)
+            loadHistogram.add (static_cast<juce::uint64> (cycles / deadline * loadScale));
+    }
+
+    // Message thread
+    void reset() { resetRequested = true; }
+    Report getReport() const
+    {
+        Report report;
+        auto microsecondsPerCycle = 1.0e6 / getCyclesPerSecond();
+        for (size_t i = 0; i < histograms.size(); i++)
+            report.stages[i] = histograms[i].summarise (microsecondsPerCycle);
+        report.load = loadHistogram.summarise (100.0 / loadScale);
+        report.numBlocks = loadHistogram.getCount();
+        return report;
+    }
+    static juce::String toJson (const Report& report)
+    {
+        auto summaryToVar = [](const Summary& summary)
+        {
+            auto* object = new juce::DynamicObject();
+            object->setProperty ("p50", summary.p50);
+            object->setProperty ("p99", summary.p99);
+            object->setProperty ("max", summary.max);
+            return juce::var (object);
+        };
+        auto* stages = new juce::DynamicObject();
+        for (size_t i = 0; i < report.stages.size(); i++)
+            stages->setProperty (stageNames[i], summaryToVar (report.stages[i]));
+
+        auto* root = new juce::DynamicObject();
+        root->setProperty ("blocks", static_cast<juce::int64> (report.numBlocks));
+        root->setProperty ("stageMicroseconds", juce::var (stages));
+        root->setProperty ("loadPercent", summaryToVar (report.load));
+        return juce::JSON::toString (juce::var (root));
+    }
+private:
+    // load is recorded in hundredths of a percent
+    static constexpr double loadScale = 10000.0;
+
+    class Histogram
+    {
+    public:
+        void add (juce::uint64 value)
+        {
+            auto& bucket = buckets[getBucket (value)];
+            bucket.store (bucket.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if (value > maximum.load (std::memory_order_relaxed))
+                maximum.store (value, std::memory_order_relaxed);
+        }
+        void clear()
+        {
+            for (auto& bucket : buckets)
+                bucket.store (0, std::memory_order_relaxed);
+            maximum.store (0, std::memory_order_relaxed);
+        }
+        juce::uint64 getCount() const
+        {
+            juce::uint64 count = 0;
+            for (const auto& bucket : buckets)
+                count += bucket.load (std::memory_order_relaxed);
+            return count;
+        }
+        Summary summarise (double unit) const
+        {
+            std::array<juce::uint32, numBuckets> counts;
+            juce::uint64 total = 0;
+            for (size_t i = 0; i < numBuckets; i++)
+            {
+                counts[i] = buckets[i].load (std::memory_order_relaxed);
+                total += counts[i];
+            }
+
+            Summary summary;
+            summary.max = static_cast<double> (maximum.load (std::memory_order_relaxed)) * unit;
+            if (total == 0)
+                return summary;
+
+            juce::uint64 seen = 0;
+            for (size_t i = 0; i < numBuckets; i++)
+            {
+                auto before = seen;
+                seen += counts[i];
+                if (before < total / 2 && seen >= total / 2)
+                    summary.p50 = getBucketMiddle (i) * unit;
+                if (before < total * 99 / 100 && seen >= total * 99 / 100)
+                    summary.p99 = getBucketMiddle (i) * unit;
+            }
+            summary.p50 = juce::jmin (summary.p50, summary.max);
+            summary.p99 = juce::jmin (summary.p99, summary.max);
+            return summary;
+        }
+    private:
+        static constexpr size_t subBuckets = 4;
+        static constexpr size_t numBuckets = 64 * subBuckets;
+
+        std::array<std::atomic<juce::uint32>, numBuckets> buckets {};
+        std::atomic<juce::uint64> maximum { 0 };
+
+        static size_t getBucket (juce::uint64 value)
+        {
+            if (value < subBuckets)
+                return static_cast<size_t> (value);
+            size_t octave = 0;
+            while ((value >> (octave + 1)) != 0)
+                octave++;
+            auto fraction = static_cast<size_t> (value >> (octave - 2)) & (subBuckets - 1);
+            return octave * subBuckets + fraction;
+        }
+        static double getBucketMiddle (size_t bucket)
+        {
+            if (bucket < subBuckets)
+                return static_cast<double> (bucket);
+            auto octave = bucket / subBuckets;
+            auto fraction = static_cast<double> (bucket % subBuckets);
+            return std::ldexp (1.0 + (fraction + 0.5) / subBuckets, static_cast<int> (octave));
+        }
+    };
+    std::array<Histogram, numStages> histograms;
+    Histogram loadHistogram;
+    std::atomic<bool> resetRequested { false };
+
+    double sampleRate = 44100.0;
+    std::atomic<juce::uint64> calibrationCycles { 0 };
+    std::atomic<juce::int64> calibrationTicks { 0 };
+    // audio thread state
+    juce::uint64 blockStart = 0;
+    juce::uint64 stageStart = 0;
+
+    static juce::uint64 readCycles()
+    {
+       #if JUCE_INTEL
+        return static_cast<juce::uint64> (__rdtsc());
+       #else
+        return static_cast<juce::uint64> (juce::Time::getHighResolutionTicks());
+       #endif
+    }
+    // The cycle counter's rate, measured against the high resolution clock
+    // over the time since prepare()
+    double getCyclesPerSecond() const
+    {
+       #if JUCE_INTEL
+        auto elapsedTicks = juce::Time::getHighResolutionTicks() - calibrationTicks.load();
+        auto elapsedCycles = readCycles() - calibrationCycles.load();
+        if (elapsedTicks > 0 && elapsedCycles > 0)
+            return static_cast<double> (elapsedCycles)
+                   * static_cast<double> (juce::Time::getHighResolutionTicksPerSecond())
+                   / static_cast<double> (elapsedTicks);
+       #endif
+        return static_cast<double> (juce::Time::getHighResolutionTicksPerSecond());
+    }
+};
+}
+
+#if ORIOTO_PROFILING
+ #define ORIOTO_PROFILE_BEGIN_BLOCK(profiler)           profiler.beginBlock()
+ #define ORIOTO_PROFILE_START(profiler)                 profiler.start()
+ #define ORIOTO_PROFILE_STOP(profiler, stage)           profiler.stop (op::StageProfiler::stage)
+ #define ORIOTO_PROFILE_END_BLOCK(profiler, numSamples) profiler.endBlock (numSamples)
+#else
+ #define ORIOTO_PROFILE_BEGIN_BLOCK(profiler)           JUCE_BLOCK_WITH_FORCED_SEMICOLON (;)
+ #define ORIOTO_PROFILE_START(profiler)                 JUCE_BLOCK_WITH_FORCED_SEMICOLON (;)
+ #define ORIOTO_PROFILE_STOP(profiler, stage)           JUCE_BLOCK_WITH_FORCED_SEMICOLON (;)
+ #define ORIOTO_PROFILE_END_BLOCK(profiler, numSamples) JUCE_BLOCK_WITH_FORCED_SEMICOLON (;)
+#endif
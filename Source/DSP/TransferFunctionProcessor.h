@@ -5,92 +5,319 @@
 #include <juce_dsp/juce_dsp.h>
 #include "../Identifiers.h"
 #include "../CurvePositionCalculator.h"
+#include "TripleBuffer.h"
+#include "CurveBank.h"
+#include "CurveCache.h"
+#include "SignalTap.h"
 
 namespace op
 {
-class TransferFunction : private juce::ValueTree::Listener
+class TransferFunction : public juce::ChangeBroadcaster,
+                         private juce::ValueTree::Listener,
+                         private juce::AsyncUpdater
 {
 public:
+    static constexpr int numAutomatedNodes = 8;
+
+    // A compiled table as published to the audio thread, for views to read
+    struct Snapshot
+    {
+        std::shared_ptr<const CurveCache::Table> table;
+        int version = 0;
+        float lookUp (float value) const { return interpolate (*table, value); }
+    };
+
     TransferFunction (juce::ValueTree activeCurveBranch)
       : state (activeCurveBranch), 
         cpc (activeCurveBranch)
     {
         jassert (state.getType() == id::ACTIVE_CURVE);
         state.addListener (this);
-        transferFunction.reset (new juce::dsp::LookupTable<float>());
-        workingBuffer.reset (new juce::dsp::LookupTable<float>());
         updateTransferFunction();
     }
+    // Sets up the audio thread's table, which waits for this so instances
+    // that are never played don't hold one
+    void prepare()
+    {
+        table.resize (numPoints + 1);
+        previousTable.resize (numPoints + 1);
+        update();
+        fadeGain = 0.0f;
+    }
     float lookUp (const float value)
     {
         jassert (value <= 1.0f);
         jassert (value >= -1.0f);
-        auto clampedValue = juce::jlimit (-1.0f, 1.0f, value);
-        float index = normalizedToIndex (clampedValue);
-        return transferFunction->get (index);
+        auto shaped = interpolate (table, value);
+        if (fadeGain <= 0.0f)
+            return shaped;
+        return shaped + fadeGain * (interpolate (previousTable, value) - shaped);
+    }
+    // Moves the crossfade to a newly picked up curve on by one sample, so
+    // switching curves while playing doesn't click. Audio thread only.
+    void advanceFade() { fadeGain = juce::jmax (0.0f, fadeGain - 1.0f / fadeLength); }
+    // The newest compiled curve, which the audio thread plays before any node
+    // offsets are applied. Message thread only; a change message follows each
+    // new one.
+    std::shared_ptr<const Snapshot> getSnapshot() const { return snapshot; }
+
+    void reset()
+    {
+        cancelPendingUpdate();
+        updateTransferFunction();
+    }
+    // Compiles the curve now if it has changed since the last compile
+    void updateNowIfNeeded() { handleUpdateNowIfNeeded(); }
+
+    // Displaces the node in the given slot (with its control points) from 
+    // the position stored in the tree. Audio thread only.
+    void setNodeOffset (int slot, juce::Point<float> offset)
+    {
+        jassert (slot >= 0 && slot < numAutomatedNodes);
+        nodeOffsets[static_cast<size_t> (slot)] = offset;
+    }
+    // Picks up a newly compiled curve and re-renders only the table range
+    // touched by changed node offsets. Audio thread only, never allocates.
+    void update()
+    {
+        if (compiledCurves.acquire())
+        {
+            // the fade starts from whatever is playing now, mid-fade or not
+            const auto& curve = compiledCurves.getReadBuffer();
+            for (size_t i = 0; i < table.size(); i++)
+                previousTable[i] = table[i] + fadeGain * (previousTable[i] - table[i]);
+            std::copy (curve.table->begin(), curve.table->end(), table.begin());
+            fadeGain = 1.0f;
+            numAutomated = juce::jmin (numAutomatedNodes, curve.nodes.size());
+            numResolved = juce::jmin (numResolvedNodes, curve.nodes.size());
+            for (int i = 0; i < numResolved; i++)
+                appliedNodes[static_cast<size_t> (i)] = curve.nodes.getReference (i);
+        }
+
+        const auto& nodes = compiledCurves.getReadBuffer().nodes;
+        for (int i = 0; i < numResolved; i++)
+            automatedNodes[static_cast<size_t> (i)] = i < numAutomated ? offsetNode (nodes, i) : nodes.getReference (i);
+        // a moved node changes the handles its type and its neighbours'
+        // derive from it, two nodes either side at most, so those are
+        // resolved again as the editor would for the same positions. The
+        // last node held is only read, unless it ends the curve.
+        auto resolvedEnd = numResolved < nodes.size() ? numResolved - 1 : numResolved;
+        CurvePositionCalculator::resolveSegmentTypes (automatedNodes.data(), numResolved, {0, resolvedEnd});
+
+        float dirtyStart = 1.0f;
+        float dirtyEnd = -1.0f;
+        for (int i = 0; i < numResolved; i++)
+        {
+            if (automatedNodes[static_cast<size_t> (i)] == appliedNodes[static_cast<size_t> (i)])
+                continue;
+
+            auto left = juce::jmax (0, i - 1);
+            auto right = juce::jmin (nodes.size() - 1, i + 1);
+            dirtyStart = juce::jmin (dirtyStart, getNode (nodes, left).endPoint.x, appliedOrBase (nodes, left).endPoint.x);
+            dirtyEnd = juce::jmax (dirtyEnd, getNode (nodes, right).endPoint.x, appliedOrBase (nodes, right).endPoint.x);
+        }
+        appliedNodes = automatedNodes;
+
+        if (dirtyStart <= dirtyEnd)
+            renderRange (nodes, dirtyStart, dirtyEnd);
     }
-    void reset() { updateTransferFunction(); }
 private:
     juce::ValueTree state;
-    static const size_t numPoints = 32 * 1;
-    std::unique_ptr<juce::dsp::LookupTable<float>> transferFunction;
-    std::unique_ptr<juce::dsp::LookupTable<float>> workingBuffer;
+    static const size_t numPoints = 2048;
     CurvePositionCalculator cpc;
 
+    // The table is shared with every other instance on the same curve. The
+    // audio thread copies it into its own table, which node offsets redraw.
+    struct CompiledCurve
+    {
+        juce::Array<Node> nodes;
+        std::shared_ptr<const CurveCache::Table> table;
+    };
+    juce::SharedResourcePointer<CurveCache> cache;
+    TripleBuffer<CompiledCurve> compiledCurves;
+    std::shared_ptr<const Snapshot> snapshot;
+
+    // audio thread state
+    std::vector<float> table;
+    // in samples at the rate the curve runs at, so a few milliseconds oversampled
+    static constexpr float fadeLength = 1024.0f;
+    std::vector<float> previousTable;
+    float fadeGain = 0.0f;
+    std::array<juce::Point<float>, numAutomatedNodes> nodeOffsets {};
+    // the automated nodes with offsets applied, and the two after them
+    // whose handles can depend on them, plus one more to read
+    static constexpr int numResolvedNodes = numAutomatedNodes + 3;
+    std::array<Node, numResolvedNodes> automatedNodes {};
+    std::array<Node, numResolvedNodes> appliedNodes {};
+    int numAutomated = 0;
+    int numResolved = 0;
+
     void updateTransferFunction()
     {
         cpc.reset (state);
-        auto f = [&](size_t i){ return cpc.getYatX (indexToNormalized (i)); };
-        workingBuffer->initialise (f, numPoints);
-        transferFunction.swap (workingBuffer);
+        // the curve is briefly empty while its nodes are being replaced
+        if (cpc.getNodes().size() < 2)
+            return;
+
+        auto& curve = compiledCurves.getWriteBuffer();
+        curve.nodes = cpc.getNodes();
+        curve.table = cache->get (curve.nodes, numPoints);
+
+        auto latest = std::make_shared<Snapshot>();
+        latest->table = curve.table;
+        latest->version = snapshot != nullptr ? snapshot->version + 1 : 0;
+        snapshot = std::move (latest);
+        compiledCurves.publish();
+        sendChangeMessage();
+    }
+    static float interpolate (const std::vector<float>& points, float value)
+    {
+        auto index = normalizedToIndex (juce::jlimit (-1.0f, 1.0f, value));
+        auto i = static_cast<size_t> (index);
+        auto fraction = index - static_cast<float> (i);
+        return points[i] + fraction * (points[i + 1] - points[i]);
+    }
+    Node offsetNode (const juce::Array<Node>& nodes, int index) const
+    {
+        auto node = nodes.getReference (index);
+        auto offset = nodeOffsets[static_cast<size_t> (index)];
+        auto position = node.endPoint;
+
+        // the outer nodes stay pinned to the edges, and no node may pass its neighbours
+        if (index > 0 && index < nodes.size() - 1)
+        {
+            auto leftLimit = automatedNodes[static_cast<size_t> (index - 1)].endPoint.x;
+            auto rightLimit = nodes.getReference (index + 1).endPoint.x;
+            position.x = juce::jlimit (leftLimit, rightLimit, position.x + offset.x);
+        }
+        position.y = juce::jlimit (-1.0f, 1.0f, position.y + offset.y);
+
+        // its handles move with it; those its type derives are resolved again after
+        auto delta = position - node.endPoint;
+        node.endPoint += delta;
+        node.controlPointOne += delta;
+        node.controlPointTwo += delta;
+        return node;
     }
-    float indexToNormalized (size_t index)
+    const Node& getNode (const juce::Array<Node>& nodes, int index) const
+    {
+        return index < numResolved ? automatedNodes[static_cast<size_t> (index)] 
+                                   : nodes.getReference (index);
+    }
+    const Node& appliedOrBase (const juce::Array<Node>& nodes, int index) const
+    {
+        return index < numResolved ? appliedNodes[static_cast<size_t> (index)] 
+                                   : nodes.getReference (index);
+    }
+    void renderRange (const juce::Array<Node>& nodes, float start, float end)
+    {
+        auto last = static_cast<int> (numPoints - 1);
+        auto first = juce::jlimit (0, last, static_cast<int> (std::floor (normalizedToIndex (start))));
+        last = juce::jlimit (0, last, static_cast<int> (std::ceil (normalizedToIndex (end))));
+
+        // an offset node never passes its unmoved right neighbour, so the sweep
+        // can start one node left of where the stored curve places it
+        auto startX = indexToNormalized (static_cast<size_t> (first));
+        int right = juce::jmax (1, CurvePositionCalculator::findRightNode (nodes, startX) - 1);
+        int segmentRight = 0;
+        Segment segment;
+        for (int i = first; i <= last; i++)
+        {
+            auto index = static_cast<size_t> (i);
+            auto x = indexToNormalized (index);
+            while (right < nodes.size() - 1 && getNode (nodes, right).endPoint.x < x)
+                right++;
+            if (right != segmentRight)
+            {
+                segment = Segment (getNode (nodes, right - 1), getNode (nodes, right));
+                segmentRight = right;
+            }
+            table[index] = segment.evaluate (x);
+        }
+        table[numPoints] = table[numPoints - 1];
+    }
+    static float indexToNormalized (size_t index)
     {
         return juce::jmap (static_cast<float> (index),
                            0.0f, static_cast<float> (numPoints - 1),
                            -1.0f, 1.0f);
     }
-    float normalizedToIndex (float normalized)
+    static float normalizedToIndex (float normalized)
     {
         return juce::jmap (normalized,
                            -1.0f, 1.0f, 
                            0.0f, static_cast<float> (numPoints - 1));
     }
+    // A drag writes each coordinate of a point and its mirrored handle, and
+    // replacing a curve adds and removes nodes one at a time, so all changes
+    // are gathered into a single rebuild per turn of the message loop
     void valueTreePropertyChanged (juce::ValueTree& tree,
                                    const juce::Identifier& property) override 
     {
         juce::ignoreUnused (property);
         if (tree.getType() == id::endPoint ||
             tree.getType() == id::controlPoint1 ||
-            tree.getType() == id::controlPoint2)
+            tree.getType() == id::controlPoint2 ||
+            property == id::segmentType)
         {
-            updateTransferFunction();
+            triggerAsyncUpdate();
         }
     }
+    void valueTreeChildAdded (juce::ValueTree& parentTree, juce::ValueTree& child) override
+    {
+        juce::ignoreUnused (child);
+        if (parentTree == state)
+            triggerAsyncUpdate();
+    }
+    void valueTreeChildRemoved (juce::ValueTree& parentTree, juce::ValueTree& child, int index) override
+    {
+        juce::ignoreUnused (child, index);
+        if (parentTree == state)
+            triggerAsyncUpdate();
+    }
+    void handleAsyncUpdate() override { updateTransferFunction(); }
 };
 
 template <typename FloatType>
 class TransferFunctionProcessor
 {
 public:
-    TransferFunctionProcessor (juce::ValueTree activeCurveBranch)
-      : transferFunction (activeCurveBranch)
-    {}
+    TransferFunctionProcessor (juce::ValueTree curveBranch)
+      : transferFunction (curveBranch.getChildWithName (id::ACTIVE_CURVE)), 
+        curveBank (curveBranch.getChildWithName (id::PRESETS))
+    {
+        jassert (curveBranch.getType() == id::CURVE);
+    }
 
     void prepare (const juce::dsp::ProcessSpec& spec) 
     {
         dryWetMix.reset (spec.sampleRate, 0.01);
+        scanPosition.reset (spec.sampleRate, 0.01);
+        transferFunction.prepare();
+        curveBank.prepare();
     }
     void reset() noexcept 
     {
         transferFunction.reset();
     }
+    void setNodeOffset (int slot, juce::Point<float> offset)
+    {
+        transferFunction.setNodeOffset (slot, offset);
+    }
+    TransferFunction& getTransferFunction() { return transferFunction; }
+    SignalTap& getSignalTap() { return signalTap; }
     
     void setMix (float newMix)
     {
         jassert (newMix >= 0.0f && newMix <= 1.0f);
         dryWetMix.setTargetValue (newMix);
     }
+    void setScan (bool enabled, float newPosition)
+    {
+        jassert (newPosition >= 0.0f && newPosition <= 1.0f);
+        scanEnabled = enabled;
+        scanPosition.setTargetValue (newPosition);
+    }
 
     template<typename ProcessContext>
     void process (const ProcessContext& context) noexcept
@@ -100,6 +327,11 @@ public:
         const auto numChannels = outputBlock.getNumChannels();
         const auto numSamples  = outputBlock.getNumSamples();
 
+        transferFunction.update();
+        curveBank.update();
+        const bool scanning = scanEnabled && ! curveBank.isEmpty();
+        const bool tapping = signalTap.isActive();
+
         if (context.isBypassed)
         {
             outputBlock.copyFrom (inputBlock);
@@ -109,14 +341,20 @@ public:
         for (size_t i = 0; i < numSamples; ++i)
         {
             auto mix = dryWetMix.getNextValue();
+            auto position = scanPosition.getNextValue();
             for (size_t channel = 0; channel < numChannels; ++channel)
             {
                 auto* inputSamples = inputBlock.getChannelPointer (channel);
                 auto* outputSamples = outputBlock.getChannelPointer (channel);
                 
-                outputSamples[i] = (mix * processSample (inputSamples[i])) + 
+                auto shaped = scanning ? curveBank.lookUp (inputSamples[i], position) 
+                                       : processSample (inputSamples[i]);
+                if (tapping && channel == 0)
+                    signalTap.push (inputSamples[i], shaped);
+                outputSamples[i] = (mix * shaped) + 
                                    ((1.0f - mix) * inputSamples[i]);
             }
+            transferFunction.advanceFade();
         }
     }
     FloatType processSample (FloatType inputValue)
@@ -125,7 +363,11 @@ public:
     }
 private:
     TransferFunction transferFunction;
+    CurveBank curveBank;
+    SignalTap signalTap;
     juce::SmoothedValue<float> dryWetMix;
+    juce::SmoothedValue<float> scanPosition;
+    bool scanEnabled = false;
 };
 
 }
\ No newline at end of file
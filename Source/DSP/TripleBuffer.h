@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+namespace op
+{
+/** Single producer, single consumer hand-off of a value type.
+    The writer fills getWriteBuffer() and calls publish(); the reader calls
+    acquire() and, if it returns true, reads the newest value through
+    getReadBuffer(). Neither side blocks or allocates.
+*/
+template <typename Type>
+class TripleBuffer
+{
+public:
+    Type& getWriteBuffer() { return buffers[static_cast<size_t> (writeIndex)]; }
+    void publish()
+    {
+        writeIndex = middle.exchange (writeIndex | dirtyFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    bool acquire()
+    {
+        if ((middle.load (std::memory_order_acquire) & dirtyFlag) == 0)
+            return false;
+
+        readIndex = middle.exchange (readIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+    const Type& getReadBuffer() const { return buffers[static_cast<size_t> (readIndex)]; }
+private:
+    static constexpr int dirtyFlag = 4;
+    static constexpr int indexMask = 3;
+
+    std::array<Type, 3> buffers;
+    int writeIndex = 0;
+    int readIndex = 1;
+    std::atomic<int> middle { 2 };
+};
+}
@@ -4,6 +4,7 @@
 #include <juce_gui_basics/juce_gui_basics.h>
 
 #include "Identifiers.h"
+#include "CurvePositionCalculator.h"
 struct NodeBranch
 {
     static const juce::ValueTree create(juce::Point<float> endPoint, 
@@ -28,30 +29,184 @@ struct NodeBranch
         nodeBranch.addChild (controlTwoBranch, -1, nullptr);
         return nodeBranch;
     }
+    static const juce::ValueTree create (const Node& node)
+    {
+        auto nodeBranch = create (node.endPoint, 
+                                  node.controlPointOne - node.endPoint, 
+                                  node.controlPointTwo - node.endPoint);
+        if (node.type != SegmentType::bezier)
+            nodeBranch.setProperty (id::segmentType, static_cast<int> (node.type), nullptr);
+        return nodeBranch;
+    }
+    static void set (juce::ValueTree nodeBranch, const Node& node, juce::UndoManager* undoManager)
+    {
+        jassert (nodeBranch.getType() == id::NODE);
+        auto setPoint = [&](const juce::Identifier& type, juce::Point<float> point)
+            {
+                auto pointBranch = nodeBranch.getChildWithName (type);
+                pointBranch.setProperty (id::x, point.x, undoManager);
+                pointBranch.setProperty (id::y, point.y, undoManager);
+            };
+        setPoint (id::endPoint, node.endPoint);
+        setPoint (id::controlPoint1, node.controlPointOne - node.endPoint);
+        setPoint (id::controlPoint2, node.controlPointTwo - node.endPoint);
+        if (node.type != SegmentType::bezier || nodeBranch.hasProperty (id::segmentType))
+            nodeBranch.setProperty (id::segmentType, static_cast<int> (node.type), undoManager);
+    }
+    // Writes nodes into a curve branch without recording them, reusing the
+    // NODE branches already there and only adding or removing the difference
+    static void setAll (juce::ValueTree curveBranch, const juce::Array<Node>& nodes)
+    {
+        while (curveBranch.getNumChildren() > nodes.size())
+            curveBranch.removeChild (curveBranch.getNumChildren() - 1, nullptr);
+        auto numReused = curveBranch.getNumChildren();
+        for (int i = 0; i < numReused; i++)
+            set (curveBranch.getChild (i), nodes.getReference (i), nullptr);
+        for (int i = numReused; i < nodes.size(); i++)
+            curveBranch.addChild (create (nodes.getReference (i)), -1, nullptr);
+    }
+};
+
+/** A change to a curve's nodes as one undoable action, stored as the run of
+    nodes that differ before and after it rather than as the properties it
+    wrote. Undoing or redoing it writes those nodes back in one go, so the
+    listeners that gather tree changes rebuild once. Further edits to the
+    same curve within a transaction are merged into it.
+*/
+class CurveEdit : public juce::UndoableAction
+{
+public:
+    CurveEdit (juce::ValueTree curveBranch, const juce::Array<Node>& before, const juce::Array<Node>& after)
+      : state (curveBranch)
+    {
+        // only a change of node count needs the whole curve
+        if (before.size() != after.size() || state.getNumChildren() != before.size())
+        {
+            oldNodes = before;
+            newNodes = after;
+            inPlace = false;
+            return;
+        }
+        auto end = before.size();
+        while (start < end && before.getReference (start) == after.getReference (start))
+            start++;
+        while (end > start && before.getReference (end - 1) == after.getReference (end - 1))
+            end--;
+        oldNodes.addArray (before, start, end - start);
+        newNodes.addArray (after, start, end - start);
+    }
+    // True if nothing would change, in which case there's no need to perform it
+    bool isEmpty() const { return inPlace && newNodes.isEmpty(); }
+
+    bool perform() override { return apply (newNodes); }
+    bool undo() override { return apply (oldNodes); }
+    int getSizeInUnits() override
+    {
+        return static_cast<int> (sizeof (*this)) + (oldNodes.size() + newNodes.size()) * static_cast<int> (sizeof (Node));
+    }
+    juce::UndoableAction* createCoalescedAction (juce::UndoableAction* nextAction) override
+    {
+        auto* next = dynamic_cast<CurveEdit*> (nextAction);
+        if (next == nullptr || next->state != state || ! inPlace || ! next->inPlace)
+            return nullptr;
+        if (isEmpty() || next->isEmpty())
+            return new CurveEdit (isEmpty() ? *next : *this);
+
+        // nodes between the two runs were changed by neither, and are read
+        // from the tree as they stand
+        auto first = juce::jmin (start, next->start);
+        auto end = juce::jmax (start + newNodes.size(), next->start + next->newNodes.size());
+        std::unique_ptr<CurveEdit> merged (new CurveEdit (*this));
+        merged->start = first;
+        merged->oldNodes.clearQuick();
+        merged->newNodes.clearQuick();
+        for (int i = first; i < end; i++)
+        {
+            auto inThis = i >= start && i < start + newNodes.size();
+            auto inNext = i >= next->start && i < next->start + next->newNodes.size();
+            auto current = inThis || inNext ? Node() : CurvePositionCalculator::readNode (state.getChild (i));
+            merged->oldNodes.add (inThis ? oldNodes.getReference (i - start) 
+                                         : inNext ? next->oldNodes.getReference (i - next->start) : current);
+            merged->newNodes.add (inNext ? next->newNodes.getReference (i - next->start)
+                                         : inThis ? newNodes.getReference (i - start) : current);
+        }
+        return merged.release();
+    }
+private:
+    juce::ValueTree state;
+    bool inPlace = true;
+    // the nodes from this index on, or the whole curve if not in place
+    int start = 0;
+    juce::Array<Node> oldNodes;
+    juce::Array<Node> newNodes;
+
+    CurveEdit (const CurveEdit&) = default;
+
+    bool apply (const juce::Array<Node>& nodes)
+    {
+        if (! inPlace)
+        {
+            NodeBranch::setAll (state, nodes);
+            return true;
+        }
+        if (state.getNumChildren() < start + nodes.size())
+            return false;
+        for (int i = 0; i < nodes.size(); i++)
+            NodeBranch::set (state.getChild (start + i), nodes.getReference (i), nullptr);
+        return true;
+    }
 };
 
 struct CurveBranch
 {
+    // Writes absolute nodes into an ACTIVE_CURVE or preset CURVE branch, 
+    // reusing its NODE branches. With an undo manager the change is 
+    // recorded as a single CurveEdit.
+    static void setNodes (juce::ValueTree curveBranch, const juce::Array<Node>& nodes, juce::UndoManager* undoManager)
+    {
+        jassert (curveBranch.getType() == id::ACTIVE_CURVE || 
+                 curveBranch.getType() == id::CURVE);
+        if (undoManager != nullptr)
+        {
+            auto edit = std::make_unique<CurveEdit> (curveBranch, CurvePositionCalculator::readNodes (curveBranch), nodes);
+            if (! edit->isEmpty())
+                undoManager->perform (edit.release());
+            return;
+        }
+        NodeBranch::setAll (curveBranch, nodes);
+    }
+    // A new state: the default factory curve active, and each factory curve
+    // listed as a preset by reference, so only the active curve is built
+    // out of branches
     static const juce::ValueTree create()
     {
         juce::ValueTree curveBranch (id::CURVE);
 
         juce::ValueTree activeBranch (id::ACTIVE_CURVE);
-        activeBranch.addChild (NodeBranch::create ({-1.0f, -1.0f}, {-0.3333333333f, -0.3333333333f}, {0.3333333333f, 0.3333333333f}), -1, nullptr);
-        activeBranch.addChild (NodeBranch::create ({0.0f, 0.0f}, {-0.3333333333f, -0.3333333333f}, {0.3333333333f, 0.3333333333f}), -1, nullptr);
-        activeBranch.addChild (NodeBranch::create ({1.0f, 1.0f}, {-0.3333333333f, -0.3333333333f}, {0.3333333333f, 0.3333333333f}), -1, nullptr);
-        activeBranch.setProperty (id::presetIndex, 0, nullptr);
+        const auto& defaultCurve = FactoryCurves::get (FactoryCurves::defaultCurve);
+        for (int i = 0; i < defaultCurve.numNodes; i++)
+        {
+            const auto& data = defaultCurve.nodes[i];
+            auto nodeBranch = NodeBranch::create ({data.x, data.y}, {data.x1, data.y1}, {data.x2, data.y2});
+            if (data.type != static_cast<int> (SegmentType::bezier))
+                nodeBranch.setProperty (id::segmentType, data.type, nullptr);
+            activeBranch.addChild (nodeBranch, -1, nullptr);
+        }
+        activeBranch.setProperty (id::presetIndex, FactoryCurves::defaultCurve, nullptr);
         curveBranch.addChild (activeBranch, -1, nullptr);
 
         juce::ValueTree presetBranch (id::PRESETS);
-        juce::ValueTree bypassCurve (id::CURVE);
-        bypassCurve.setProperty (id::name, "Bypass", nullptr);
-        bypassCurve.addChild (NodeBranch::create ({-1.0f, -1.0f}, {-0.3333333333f, -0.3333333333f}, {0.3333333333f, 0.3333333333f}), -1, nullptr);
-        bypassCurve.addChild (NodeBranch::create ({0.0f, 0.0f}, {-0.3333333333f, -0.3333333333f}, {0.3333333333f, 0.3333333333f}), -1, nullptr);
-        bypassCurve.addChild (NodeBranch::create ({1.0f, 1.0f}, {-0.3333333333f, -0.3333333333f}, {0.3333333333f, 0.3333333333f}), -1, nullptr);
-        presetBranch.addChild (bypassCurve, -1, nullptr);
+        for (int i = 0; i < FactoryCurves::numCurves; i++)
+        {
+            juce::ValueTree factoryCurve (id::CURVE);
+            factoryCurve.setProperty (id::name, FactoryCurves::get (i).name, nullptr);
+            factoryCurve.setProperty (id::factoryCurve, i, nullptr);
+            presetBranch.addChild (factoryCurve, -1, nullptr);
+        }
         curveBranch.addChild (presetBranch, -1, nullptr);
 
+        curveBranch.addChild (juce::ValueTree (id::HARMONICS), -1, nullptr);
+
         return curveBranch;
     }
 };
@@ -0,0 +1,40 @@
+#pragma once
+
+/** The curves every new state starts with, compiled into the binary and
+    shared by every instance. A preset branch refers to one through its
+    factoryCurve property and holds no nodes of its own; readers take the
+    nodes from here. Each node is its end point and its control points
+    relative to it, as in the tree, and its segment type.
+*/
+struct FactoryCurves
+{
+    struct NodeData
+    {
+        float x, y;
+        float x1, y1;
+        float x2, y2;
+        int type;
+    };
+    struct Curve
+    {
+        const char* name;
+        const NodeData* nodes;
+        int numNodes;
+    };
+
+    static constexpr NodeData bypassNodes[]
+    {
+        {-1.0f, -1.0f, -0.3333333333f, -0.3333333333f, 0.3333333333f, 0.3333333333f, 0},
+        { 0.0f,  0.0f, -0.3333333333f, -0.3333333333f, 0.3333333333f, 0.3333333333f, 0},
+        { 1.0f,  1.0f, -0.3333333333f, -0.3333333333f, 0.3333333333f, 0.3333333333f, 0}
+    };
+    static constexpr Curve curves[]
+    {
+        {"Bypass", bypassNodes, 3}
+    };
+    static constexpr int numCurves = static_cast<int> (sizeof (curves) / sizeof (curves[0]));
+    // The curve a new state starts with
+    static constexpr int defaultCurve = 0;
+
+    static constexpr const Curve& get (int index) { return curves[index]; }
+};
@@ -11,11 +11,16 @@ static const juce::Identifier controlPoint2 = "controlPoint2";
 static const juce::Identifier endPoint = "endPoint";
 static const juce::Identifier y = "y";
 static const juce::Identifier x = "x";
+static const juce::Identifier segmentType = "segmentType";
 
 static const juce::Identifier CURVE = "CURVE";
 static const juce::Identifier ACTIVE_CURVE = "ACTIVE_CURVE";
 static const juce::Identifier presetIndex = "presetIndex";
+static const juce::Identifier libraryHash = "libraryHash";
 static const juce::Identifier PRESETS = "PRESETS";
 static const juce::Identifier name = "name";
+static const juce::Identifier inScan = "inScan";
+static const juce::Identifier factoryCurve = "factoryCurve";
+static const juce::Identifier HARMONICS = "HARMONICS";
 
 }
\ No newline at end of file
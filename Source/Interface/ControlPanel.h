@@ -3,6 +3,8 @@
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 #include "AttachedSlider.h"
+#include "MeterBar.h"
+#include "../DSP/Metering.h"
 namespace oi
 {
 
@@ -31,6 +33,14 @@ public:
     {
       return getLocalBounds().removeFromBottom ((int) (getHeight() * 0.8));
     }
+protected:
+    static constexpr int meterWidth = 8;
+
+    static void showLevel (MeterBar& bar, op::LevelMeter& meter)
+    {
+        bar.setLevels (juce::Decibels::gainToDecibels (meter.getRms(), op::Meters::silenceDecibels),
+                       juce::Decibels::gainToDecibels (meter.takePeak(), op::Meters::silenceDecibels));
+    }
 private:
     juce::String name;
 };
@@ -42,13 +52,18 @@ public:
         gain ("Gain", "InputGain", vts)
     {
         addAndMakeVisible (gain);
+        addAndMakeVisible (level);
     }
     void resized() override
     {
-        gain.setBounds (getAdjustedBounds());
+        auto b = getAdjustedBounds();
+        level.setBounds (b.removeFromRight (meterWidth).reduced (0, 4));
+        gain.setBounds (b);
     }
+    void updateMeters (op::Meters& meters) { showLevel (level, meters.input); }
 private:
     AttachedSlider gain;
+    MeterBar level;
 };
 class LowShelfPanel : public Panel
 {
@@ -91,21 +106,28 @@ public:
         addAndMakeVisible (ratio);
         addAndMakeVisible (attack);
         addAndMakeVisible (release);
+        addAndMakeVisible (gainReduction);
     }
     void resized()
     {
         auto b = getAdjustedBounds();
+        gainReduction.setBounds (b.removeFromRight (meterWidth).reduced (0, 4));
         auto unitWidth = b.getWidth() / 4;
         threshold.setBounds (b.removeFromLeft (unitWidth));
         ratio.setBounds (b.removeFromLeft (unitWidth));
         attack.setBounds (b.removeFromLeft (unitWidth));
         release.setBounds (b.removeFromLeft (unitWidth));
     }
+    void updateMeters (op::Meters& meters)
+    {
+        gainReduction.setGainReduction (meters.inputCompressorOut.getGainReduction());
+    }
 private:
     AttachedSlider threshold;
     AttachedSlider ratio;
     AttachedSlider attack;
     AttachedSlider release;
+    MeterBar gainReduction { MeterBar::Style::gainReduction };
 };
 class BlendPanel : public Panel
 {
@@ -123,6 +145,28 @@ public:
 private:
     AttachedSlider blend;
 };
+class ScanPanel : public Panel
+{
+public:
+    ScanPanel (juce::AudioProcessorValueTreeState& vts)
+      : Panel ("Curve Scan"), 
+        mode ("Mode", "CurveScan", vts), 
+        position ("Position", "ScanPosition", vts)
+    {
+        addAndMakeVisible (mode);
+        addAndMakeVisible (position);
+    }
+    void resized() override
+    {
+        auto b = getAdjustedBounds();
+        auto unitWidth = b.getWidth() / 2;
+        mode.setBounds (b.removeFromLeft (unitWidth));
+        position.setBounds (b.removeFromLeft (unitWidth));
+    }
+private:
+    AttachedSlider mode;
+    AttachedSlider position;
+};
 class HighShelfPanel : public Panel
 {
 public:
@@ -180,21 +224,28 @@ public:
         addAndMakeVisible (ratio);
         addAndMakeVisible (attack);
         addAndMakeVisible (release);
+        addAndMakeVisible (gainReduction);
     }
     void resized()
     {
         auto b = getAdjustedBounds();
+        gainReduction.setBounds (b.removeFromRight (meterWidth).reduced (0, 4));
         auto unitWidth = b.getWidth() / 4;
         threshold.setBounds (b.removeFromLeft (unitWidth));
         ratio.setBounds (b.removeFromLeft (unitWidth));
         attack.setBounds (b.removeFromLeft (unitWidth));
         release.setBounds (b.removeFromLeft (unitWidth));
     }
+    void updateMeters (op::Meters& meters)
+    {
+        gainReduction.setGainReduction (meters.outputCompressorOut.getGainReduction());
+    }
 private:
     AttachedSlider threshold;
     AttachedSlider ratio;
     AttachedSlider attack;
     AttachedSlider release;
+    MeterBar gainReduction { MeterBar::Style::gainReduction };
 };
 class OutputLevelPanel : public Panel
 {
@@ -207,16 +258,21 @@ public:
         outputLevelSlider.setTextBoxStyle (juce::Slider::TextEntryBoxPosition::NoTextBox, true, 200, 20);
         addAndMakeVisible (outputLevelSlider);
         outputLevelAttachment.reset (new SliderAttachment (valueTreeState, "OutputLevel", outputLevelSlider));
+        addAndMakeVisible (level);
     }
     void resized()
     {
-        outputLevelSlider.setBounds (getAdjustedBounds());
+        auto b = getAdjustedBounds();
+        level.setBounds (b.removeFromRight (meterWidth).reduced (0, 4));
+        outputLevelSlider.setBounds (b);
     }
+    void updateMeters (op::Meters& meters) { showLevel (level, meters.output); }
 private:
     juce::AudioProcessorValueTreeState& valueTreeState;
     juce::Label outputLeveLabel;
     juce::Slider outputLevelSlider;
     std::unique_ptr<SliderAttachment> outputLevelAttachment;
+    MeterBar level;
 };
 class InnerControlPannel : public juce::Component 
 {
@@ -226,6 +282,7 @@ public:
         lowShelfPanel (vts),
         inputCompressionPanel (vts), 
         blendPanel (vts),
+        scanPanel (vts),
         highShelfPanel (vts),
         lowPassPanel (vts),
         outputCompressionPanel (vts)
@@ -234,6 +291,7 @@ public:
         addAndMakeVisible (lowShelfPanel);
         addAndMakeVisible (inputCompressionPanel);
         addAndMakeVisible (blendPanel);
+        addAndMakeVisible (scanPanel);
         addAndMakeVisible (highShelfPanel);
         addAndMakeVisible (lowPassPanel);
         addAndMakeVisible (outputCompressionPanel);
@@ -242,48 +300,71 @@ public:
     {
         auto b = getLocalBounds();
         b.removeFromRight (10);
-        auto unitHeight = b.getHeight() / 7;
+        auto unitHeight = b.getHeight() / 8;
         inputGainPanel.setBounds (b.removeFromTop (unitHeight).reduced (0));
         lowShelfPanel.setBounds (b.removeFromTop (unitHeight).reduced (0));
         inputCompressionPanel.setBounds (b.removeFromTop (unitHeight).reduced (0));
         blendPanel.setBounds (b.removeFromTop (unitHeight).reduced (0));
+        scanPanel.setBounds (b.removeFromTop (unitHeight).reduced (0));
         highShelfPanel.setBounds (b.removeFromTop (unitHeight).reduced (0));
         lowPassPanel.setBounds (b.removeFromTop (unitHeight).reduced (0));
         outputCompressionPanel.setBounds (b.removeFromTop (unitHeight).reduced (0));
     }
+    void updateMeters (op::Meters& meters)
+    {
+        inputGainPanel.updateMeters (meters);
+        inputCompressionPanel.updateMeters (meters);
+        outputCompressionPanel.updateMeters (meters);
+    }
 private:
     InputGainPanel inputGainPanel;
     LowShelfPanel lowShelfPanel;
     InputCompressionPanel inputCompressionPanel;
     BlendPanel blendPanel;
+    ScanPanel scanPanel;
     HighShelfPanel highShelfPanel;
     LowPassPanel lowPassPanel;
     OutputCompressionPanel outputCompressionPanel;
 };
-class ControlPanel : public juce::Component
+// Meters in every panel are updated together from the one timer here
+class ControlPanel : public juce::Component,
+                     private juce::Timer
 {
 public:
-    ControlPanel (juce::AudioProcessorValueTreeState& vts)
-      : viewPort ("Inner Control Pannel"),
+    ControlPanel (juce::AudioProcessorValueTreeState& vts, op::Meters& m)
+      : meters (m),
+        viewPort ("Inner Control Pannel"),
         outputLevelPanel (vts)
     {
-        viewPort.setViewedComponent(new InnerControlPannel (vts));
+        innerControlPanel = new InnerControlPannel (vts);
+        viewPort.setViewedComponent (innerControlPanel);
         viewPort.setScrollBarThickness (10);
         viewPort.setScrollBarsShown (true, false);
         addAndMakeVisible (viewPort);
         addAndMakeVisible (outputLevelPanel);
+        startTimerHz (meterRate);
     }
     void resized() override
     { 
         auto b = getLocalBounds();
         outputLevelPanel.setBounds (b.removeFromBottom (100).reduced (2));
         viewPort.setBounds (b);
-        juce::Rectangle<int> innerViewBounds = {getLocalBounds().getWidth(), 800};
+        juce::Rectangle<int> innerViewBounds = {getLocalBounds().getWidth(), 915};
         auto vc = viewPort.getViewedComponent();
         vc->setBounds (innerViewBounds);
     }
 private:
+    static constexpr int meterRate = 30;
+
+    op::Meters& meters;
     juce::Viewport viewPort;
+    InnerControlPannel* innerControlPanel = nullptr; // owned by viewPort
     OutputLevelPanel outputLevelPanel;
+
+    void timerCallback() override
+    {
+        innerControlPanel->updateMeters (meters);
+        outputLevelPanel.updateMeters (meters);
+    }
 };
 }
\ No newline at end of file
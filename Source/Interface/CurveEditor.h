@@ -2,126 +2,17 @@
 
 #include <juce_gui_basics/juce_gui_basics.h>
 #include "../Identifiers.h"
+#include "../CurvePositionCalculator.h"
 #include "LookAndFeel.hpp"
+#include "HarmonicDesigner.h"
+#include "../CurveCapture.h"
+#include "../CurveFile.h"
+#include "../CurveOperations.h"
+#include "../PresetLibrary.h"
+#include <map>
 
 namespace oi
 {
-class DraggablePoint : public juce::Component
-{
-public: 
-    DraggablePoint (juce::ValueTree NodeBranch, juce::UndoManager& um) 
-      : state (NodeBranch), 
-        undoManager (um),
-        x (state, id::x, &undoManager), 
-        y (state, id::y, &undoManager)
-    {
-        jassert (state.getType() == id::endPoint ||
-                 state.getType() == id::controlPoint1 ||
-                 state.getType() == id::controlPoint2);
-    }
-    void mouseEnter (const juce::MouseEvent& event) override 
-    {
-        juce::ignoreUnused (event);
-        mouseOver = true;
-        repaint();
-    }
-    void mouseExit (const juce::MouseEvent& event) override 
-    {
-        juce::ignoreUnused (event);
-        mouseOver = false;
-        repaint();
-    }
-    void mouseDrag (const juce::MouseEvent& event) override 
-    { 
-        juce::ignoreUnused (event); 
-        listener->isDragging = true;
-        listener->onDrag (this, event);
-    }
-    void mouseDown (const juce::MouseEvent& event) override 
-    { 
-        juce::ignoreUnused (event); 
-        undoManager.beginNewTransaction ("Point Dragged");
-    }
-    void mouseUp (const juce::MouseEvent& event) override 
-    {
-        juce::ignoreUnused (event);
-        listener->isDragging = false;
-        listener->onDragEnd();
-    }
-    const juce::Point<float> getPosition() const { return juce::Point<float> (x.get(), y.get()); }
-    void setPosition (juce::Point<float> newPosition)
-    {
-        x.setValue (newPosition.getX(), &undoManager);
-        y.setValue (newPosition.getY(), &undoManager);
-    }
-    struct Listener
-    {
-        virtual void onDrag (DraggablePoint*, const juce::MouseEvent&) = 0;
-        virtual void onDragEnd () = 0;
-        bool isDragging = false;
-    };
-    void setListener (Listener* newListener) { listener = newListener; }
-protected:
-    juce::ValueTree state;
-    juce::UndoManager& undoManager;
-    juce::CachedValue<float> x,y;
-
-    bool mouseOver = false;
-    Listener* listener;
-};
-class Node;
-class EndPoint : public DraggablePoint
-{
-public:
-    EndPoint (Node& parent, juce::ValueTree endpointBranch, juce::UndoManager& um)
-      : DraggablePoint (endpointBranch, um), 
-        parentNode (parent)
-    {
-        jassert (state.getType() == id::endPoint);
-    }
-    void paint (juce::Graphics& g) override
-    {
-        auto laf = dynamic_cast<OriotoLookAndFeel*> (&getLookAndFeel());
-        jassert (laf != nullptr);
-
-        g.setColour (laf->getAccentColour());
-        auto b = getLocalBounds();
-        g.fillEllipse (b.toFloat());
-
-        g.setColour (laf->getBackgroundColour());
-        mouseOver ? g.fillEllipse (b.reduced (4).toFloat()) : g.fillEllipse (b.reduced (2).toFloat());
-    }
-    Node& getNode() { return parentNode; }
-private:
-    Node& parentNode;
-};
-
-class ControlPoint : public DraggablePoint
-{
-public:
-    ControlPoint (Node& node, juce::ValueTree controlPointBranch, juce::UndoManager& um)
-      : DraggablePoint (controlPointBranch, um), 
-        parentNode (node)
-    {
-        jassert (state.getType() == id::controlPoint1 || 
-                 state.getType() == id::controlPoint2);
-    }
-    void paint (juce::Graphics& g) override
-    {
-        auto laf = dynamic_cast<OriotoLookAndFeel*> (&getLookAndFeel());
-        jassert (laf != nullptr);
-
-        g.setColour (laf->getAccentColour().darker (0.5f));
-        auto b = getLocalBounds();
-        g.fillEllipse (b.toFloat());
-
-        g.setColour (laf->getBackgroundColour());
-        mouseOver ? g.fillEllipse (b.reduced (4).toFloat()) : g.fillEllipse (b.reduced (2).toFloat());
-    }
-    Node& getNode() { return parentNode; }
-private:
-    Node& parentNode;
-};
 static juce::Point<float> scaleToBounds (const juce::Point<float> normalized, const juce::Rectangle<int> localBounds)
 {
     auto output = juce::Point<float>();
@@ -138,307 +29,570 @@ static juce::Point<float> scaleFromBounds (const juce::Point<float> boundsPositi
     output.setY (juce::jmap (boundsPosition.getY(), static_cast<float> (b.getHeight()), 0.0f, -1.0f, 1.0f));
     return output;
 }
-class Node : public juce::Component, 
-             private juce::ValueTree::Listener
+/** The editable curve and all of its handles, drawn by one component.
+    Handles are found through the nodes' sorted x positions, so hit tests
+    and painting only visit the nodes near the area concerned. Each segment's
+    stroked outline is cached, and an edit rebuilds and repaints just the
+    segments around the node that changed, over a cached background. Edits
+    are gathered until the message loop comes round, so a drag that writes
+    several properties costs one update.
+*/
+class Curve : public juce::Component, 
+              private juce::ValueTree::Listener,
+              private juce::AsyncUpdater
 {
 public:
-    Node (juce::ValueTree nodeBranch, juce::UndoManager& um)
-      : state (nodeBranch), 
-        undoManager (um), 
-        endPoint (*this, nodeBranch.getChildWithName (id::endPoint), undoManager), 
-        controlPointOne (*this, nodeBranch.getChildWithName (id::controlPoint1), undoManager), 
-        controlPointTwo (*this, nodeBranch.getChildWithName (id::controlPoint2), undoManager)
-    {
-        jassert (state.getType() == id::NODE);
-        addAndMakeVisible (endPoint);
-        addAndMakeVisible (controlPointOne);
-        addAndMakeVisible (controlPointTwo);
-        state.addListener (this);
-    }
-    void resized() override
+    Curve (juce::ValueTree activeCurveBranch, juce::UndoManager& um) 
+      : state (activeCurveBranch), 
+        undoManager (um)
     {
-        juce::Rectangle<int> ep (20, 20);
-        endPoint.setBounds (ep.withCentre (scaleToBounds (endPoint.getPosition(), getLocalBounds()).toInt()));
-        juce::Rectangle<int> cp (12, 12);
-        controlPointOne.setBounds (cp.withCentre (scaleToBounds (endPoint.getPosition() + controlPointOne.getPosition(), getLocalBounds()).toInt()));
-        controlPointTwo.setBounds (cp.withCentre (scaleToBounds (endPoint.getPosition() + controlPointTwo.getPosition(), getLocalBounds()).toInt()));
+        jassert (state.getType() == id::ACTIVE_CURVE);
+        setOpaque (true);
+        state.addListener (this);
+        resetNodes();
     }
     void paint (juce::Graphics& g) override
     {
         auto laf = dynamic_cast<OriotoLookAndFeel*> (&getLookAndFeel());
         jassert (laf != nullptr);
+        if (background.isValid())
+            g.drawImage (background, getLocalBounds().toFloat());
+        else
+            g.fillAll (laf->getBaseColour());
+
+        if (drawnNodes.size() < 2)
+            return;
 
-        g.setColour (laf->getAccentColour().darker (0.5f));
-        juce::Line<float> toControlPointOne (scaleToBounds (endPoint.getPosition() + controlPointOne.getPosition(), getLocalBounds()), 
-                                             scaleToBounds (endPoint.getPosition(), getLocalBounds()));
-        g.drawLine (toControlPointOne, 2.0f);  
-        juce::Line<float> toControlPointTwo (scaleToBounds (endPoint.getPosition() + controlPointTwo.getPosition(), getLocalBounds()), 
-                                             scaleToBounds (endPoint.getPosition(), getLocalBounds()));
-        g.drawLine (toControlPointTwo, 2.0f);
+        auto clip = g.getClipBounds().toFloat();
+        auto range = getNodesNear (clip.getX() - endPointSize, clip.getRight() + endPointSize);
+
+        g.setColour (laf->getAccentColour());
+        for (int i = range.getStart(); i < range.getEnd() - 1; i++)
+            g.fillPath (segmentOutlines[static_cast<size_t> (i)]);
 
+        if (isDragging)
+        {
+            g.setColour (laf->getBackgroundColour());
+            auto cursorPosition = toScreen (draggingPosition);
+            g.drawLine (cursorPosition.getX(), 0.0f, cursorPosition.getX(), static_cast<float> (getHeight()));
+            g.drawLine (0.0f, cursorPosition.getY(), static_cast<float> (getWidth()), cursorPosition.getY());
+        }
+
+        for (int i = range.getStart(); i < range.getEnd(); i++)
+            paintHandles (g, *laf, i);
     }
-    bool hitTest(int x, int y) override 
-    { 
-        juce::Point<int> hit (x, y);
-        if (endPoint.getBounds().contains (hit)) return true;
-        if (controlPointOne.getBounds().contains (hit)) return true;
-        if (controlPointTwo.getBounds().contains (hit)) return true;
-        return false;
+
+    void resized() override
+    {
+        renderBackground();
+        updateOutlines ({0, drawnNodes.size() - 1});
     }
-    void addListener (DraggablePoint::Listener* l)
+
+    void mouseMove (const juce::MouseEvent& event) override
     {
-        endPoint.setListener (l);
-        controlPointOne.setListener (l);
-        controlPointTwo.setListener (l);
+        handleUpdateNowIfNeeded();
+        setHovered (findHandle (event.position));
     }
-    const juce::Point<float> getPosition() const { return endPoint.getPosition(); }
-    void setPosition (juce::Point<float> position)
+    void mouseExit (const juce::MouseEvent& event) override
     {
-        endPoint.setPosition (position);
+        juce::ignoreUnused (event);
+        setHovered ({});
+    }
+    void mouseDown (const juce::MouseEvent& event) override
+    {
+        handleUpdateNowIfNeeded();
+        dragged = findHandle (event.position);
+        if (dragged.node < 0)
+            return;
+
+        dragStartNodes = storedNodes;
+        dragStartTime = juce::Time::getMillisecondCounter();
+        if (event.mods.isPopupMenu() && dragged.part == Part::endPoint)
+            showSegmentTypeMenu (dragged.node);
+    }
+    void mouseDrag (const juce::MouseEvent& event) override
+    {
+        if (dragged.node < 0 || dragged.node >= storedNodes.size() || event.mods.isPopupMenu())
+            return;
+
+        // hit tests and drag limits need the nodes as they are now
+        handleUpdateNowIfNeeded();
+        repaintCrosshair();
+        isDragging = true;
+        auto position = scaleFromBounds (event.position, getLocalBounds());
+        if (dragged.part == Part::endPoint)
+            dragEndPoint (dragged.node, position);
+        else
+            dragControlPoint (dragged.node, dragged.part, position);
+        repaintCrosshair();
+    }
+    void mouseUp (const juce::MouseEvent& event) override
+    {
+        if (isDragging)
+        {
+            repaintCrosshair();
+            recordDrag();
+        }
+        isDragging = false;
+        dragged = {};
+        setHovered (findHandle (event.position));
     }
-    ControlPoint& getControlPointOne() { return controlPointOne; }
-    ControlPoint& getControlPointTwo() { return controlPointTwo; }
-    EndPoint& getEndPoint() { return endPoint; }
 private:
     juce::ValueTree state;
     juce::UndoManager& undoManager;
 
-    EndPoint endPoint;
-    ControlPoint controlPointOne, controlPointTwo;
+    // as stored in the tree, and as compiled (derived control points resolved)
+    juce::Array<Node> storedNodes;
+    juce::Array<Node> drawnNodes;
+    // nodes changed in the tree since the last update, or whether nodes
+    // were added, removed or reordered
+    juce::Range<int> pendingNodes;
+    bool needsReset = false;
+    // the nodes as the current drag found them, and the last recorded drag
+    juce::Array<Node> dragStartNodes;
+    juce::uint32 dragStartTime = 0;
+    int lastDraggedNode = -1;
+    juce::uint32 lastDragTime = 0;
+    // stroked outline of the segment from each node to the next, in screen space
+    std::vector<juce::Path> segmentOutlines;
+    juce::Image background;
 
-    void valueTreePropertyChanged (juce::ValueTree& tree,
-                                   const juce::Identifier& property) override
+    static constexpr float endPointSize = 20.0f;
+    static constexpr float controlPointSize = 12.0f;
+    static constexpr float strokeWidth = 4.0f;
+    static constexpr int gridDivisions = 4;
+
+    enum class Part { endPoint, controlPointOne, controlPointTwo };
+    struct Handle
     {
-        juce::ignoreUnused (property);
-        if (tree.getType() == id::endPoint) resized();
-        if (tree.getType() == id::controlPoint1)
-        {
-            if (property == id::x || property == id::y)
-                controlPointTwo.setPosition (mirrorPosition (controlPointOne.getPosition()));
-            
-            resized();
-        } 
-        if (tree.getType() == id::controlPoint2)
-        {
-            if (property == id::x || property == id::y)
-                controlPointOne.setPosition (mirrorPosition (controlPointTwo.getPosition()));
+        int node = -1;
+        Part part = Part::endPoint;
+        bool operator== (const Handle& other) const { return node == other.node && part == other.part; }
+        bool operator!= (const Handle& other) const { return ! operator== (other); }
+    };
+    Handle hovered, dragged;
+    bool isDragging = false;
+    juce::Point<float> draggingPosition;
 
-            resized();
-        } 
+    juce::Point<float> toScreen (juce::Point<float> normalized) const { return scaleToBounds (normalized, getLocalBounds()); }
+    float toNormalizedX (float screenX) const
+    {
+        return juce::jmap (screenX, 0.0f, static_cast<float> (juce::jmax (1, getWidth())), -1.0f, 1.0f);
     }
+    bool showsControlPoints (int index) const { return storedNodes.getReference (index).type == SegmentType::bezier; }
 
-    juce::Point<float> mirrorPosition (const juce::Point<float> positionToMirror)
+    // Every node whose segments or control points can reach between the two
+    // screen x positions. Control points never pass the neighbouring nodes,
+    // so one node either side of the sorted search is enough.
+    juce::Range<int> getNodesNear (float left, float right) const
     {
-        return {positionToMirror.getX() * -1.0f, positionToMirror.getY() * -1.0f};
+        if (drawnNodes.size() < 2)
+            return {0, drawnNodes.size()};
+
+        auto first = CurvePositionCalculator::findRightNode (drawnNodes, toNormalizedX (left)) - 2;
+        auto last = CurvePositionCalculator::findRightNode (drawnNodes, toNormalizedX (right)) + 1;
+        return {juce::jmax (0, first), juce::jmin (drawnNodes.size(), last + 1)};
     }
-};
-class Curve : public juce::Component, 
-              private DraggablePoint::Listener, 
-              private juce::ValueTree::Listener
-{
-public:
-    Curve (juce::ValueTree activeCurveBranch, juce::UndoManager& um) 
-      : state (activeCurveBranch), 
-        undoManager (um)
+    juce::Point<float> getHandlePosition (const Handle& handle) const
     {
-        jassert (state.getType() == id::ACTIVE_CURVE);
-        state.addListener (this);
-        resetNodes();
+        const auto& node = drawnNodes.getReference (handle.node);
+        switch (handle.part)
+        {
+            case Part::controlPointOne: return toScreen (node.controlPointOne);
+            case Part::controlPointTwo: return toScreen (node.controlPointTwo);
+            case Part::endPoint: break;
+        }
+        return toScreen (node.endPoint);
     }
-    void paint (juce::Graphics& g) override
+    juce::Rectangle<float> getHandleBounds (const Handle& handle) const
     {
-        auto laf = dynamic_cast<OriotoLookAndFeel*> (&getLookAndFeel());
-        jassert (laf != nullptr);
-        g.fillAll (laf->getBaseColour());
+        auto size = handle.part == Part::endPoint ? endPointSize : controlPointSize;
+        return juce::Rectangle<float> (size, size).withCentre (getHandlePosition (handle));
+    }
+    // Topmost handle under the position: later nodes over earlier ones, and
+    // control points over their endpoint, as they are painted
+    Handle findHandle (juce::Point<float> position) const
+    {
+        auto range = getNodesNear (position.x - endPointSize, position.x + endPointSize);
+        for (int i = range.getEnd() - 1; i >= range.getStart(); i--)
+        {
+            for (auto part : {Part::controlPointTwo, Part::controlPointOne, Part::endPoint})
+            {
+                if (part != Part::endPoint && ! showsControlPoints (i))
+                    continue;
+                if (getHandleBounds ({i, part}).contains (position))
+                    return {i, part};
+            }
+        }
+        return {};
+    }
+    void setHovered (const Handle& handle)
+    {
+        if (handle == hovered)
+            return;
+        if (hovered.node >= 0 && hovered.node < drawnNodes.size())
+            repaint (getHandleBounds (hovered).getSmallestIntegerContainer());
+        hovered = handle;
+        if (hovered.node >= 0)
+            repaint (getHandleBounds (hovered).getSmallestIntegerContainer());
+    }
 
-        g.setColour (laf->getAccentColour());
-        juce::Path curvePath;
-        auto initialPoint = scaleToBounds (nodes.getFirst()->getPosition(), getLocalBounds());
+    void paintHandles (juce::Graphics& g, OriotoLookAndFeel& laf, int index) const
+    {
+        auto paintPoint = [&](const Handle& handle, juce::Colour colour)
+            {
+                auto b = getHandleBounds (handle);
+                g.setColour (colour);
+                g.fillEllipse (b);
+                g.setColour (laf.getBackgroundColour());
+                g.fillEllipse (b.reduced (handle == hovered ? 4.0f : 2.0f));
+            };
 
-        curvePath.startNewSubPath (initialPoint);
-        auto previousControlPoint = scaleToBounds (nodes.getFirst()->getEndPoint().getPosition() + nodes.getFirst()->getControlPointTwo().getPosition(), getLocalBounds());
-        for (int i = 1; i < nodes.size(); i++)
+        auto endPoint = getHandlePosition ({index, Part::endPoint});
+        if (showsControlPoints (index))
         {
-            curvePath.cubicTo (previousControlPoint,
-                               scaleToBounds (nodes[i]->getEndPoint().getPosition() + nodes[i]->getControlPointOne().getPosition(), getLocalBounds()),
-                               scaleToBounds (nodes[i]->getEndPoint().getPosition(), getLocalBounds()));
-            previousControlPoint = scaleToBounds (nodes[i]->getEndPoint().getPosition() + nodes[i]->getControlPointTwo().getPosition(), getLocalBounds());
+            g.setColour (laf.getAccentColour().darker (0.5f));
+            g.drawLine ({getHandlePosition ({index, Part::controlPointOne}), endPoint}, 2.0f);
+            g.drawLine ({getHandlePosition ({index, Part::controlPointTwo}), endPoint}, 2.0f);
+            paintPoint ({index, Part::controlPointOne}, laf.getAccentColour().darker (0.5f));
+            paintPoint ({index, Part::controlPointTwo}, laf.getAccentColour().darker (0.5f));
         }
-        g.strokePath (curvePath.createPathWithRoundedCorners (2.0f), juce::PathStrokeType (4.0f));
+        paintPoint ({index, Part::endPoint}, laf.getAccentColour());
+    }
+    // Base fill and grid, redrawn only when the size changes
+    void renderBackground()
+    {
+        auto scale = juce::Component::getApproximateScaleFactorForComponent (this);
+        background = juce::Image (juce::Image::RGB,
+                                  juce::jmax (1, juce::roundToInt (static_cast<float> (getWidth()) * scale)),
+                                  juce::jmax (1, juce::roundToInt (static_cast<float> (getHeight()) * scale)),
+                                  false);
+        juce::Graphics g (background);
+        g.addTransform (juce::AffineTransform::scale (scale));
+        g.fillAll (OriotoLookAndFeel::getBaseColour());
 
-        if (isDragging)
+        g.setColour (OriotoLookAndFeel::getBackgroundColour().withAlpha (0.5f));
+        for (int i = 1; i < gridDivisions; i++)
         {
-            g.setColour (laf->getBackgroundColour());
-            auto cursorPosition = scaleToBounds (draggingPosition, getLocalBounds());
-            g.drawLine (cursorPosition.getX(), 0.0f, cursorPosition.getX(), static_cast<float> (getLocalBounds().getHeight()));
-            g.drawLine (0.0f, cursorPosition.getY(), static_cast<float> (getLocalBounds().getWidth()), cursorPosition.getY());
+            auto position = static_cast<float> (i) / gridDivisions;
+            g.drawVerticalLine (juce::roundToInt (position * static_cast<float> (getWidth())), 0.0f, static_cast<float> (getHeight()));
+            g.drawHorizontalLine (juce::roundToInt (position * static_cast<float> (getHeight())), 0.0f, static_cast<float> (getWidth()));
         }
     }
-    void resized() override
+    void updateOutlines (juce::Range<int> segments)
+    {
+        segmentOutlines.resize (static_cast<size_t> (juce::jmax (0, drawnNodes.size() - 1)));
+        juce::PathStrokeType stroke (strokeWidth, juce::PathStrokeType::curved, juce::PathStrokeType::rounded);
+        for (int i = segments.getStart(); i < segments.getEnd(); i++)
+        {
+            // drawn from the compiled nodes so derived segment types show as they sound
+            juce::Path segment;
+            segment.startNewSubPath (toScreen (drawnNodes.getReference (i).endPoint));
+            segment.cubicTo (toScreen (drawnNodes.getReference (i).controlPointTwo),
+                             toScreen (drawnNodes.getReference (i + 1).controlPointOne),
+                             toScreen (drawnNodes.getReference (i + 1).endPoint));
+            stroke.createStrokedPath (segmentOutlines[static_cast<size_t> (i)], segment);
+        }
+    }
+    juce::Rectangle<float> getRegion (juce::Range<int> nodeRange, juce::Range<int> segments) const
     {
-        for (auto* node : nodes)
-            node->setBounds (getLocalBounds());
+        juce::Rectangle<float> region;
+        for (int i = segments.getStart(); i < segments.getEnd(); i++)
+            region = region.getUnion (segmentOutlines[static_cast<size_t> (i)].getBounds());
+        for (int i = nodeRange.getStart(); i < nodeRange.getEnd(); i++)
+        {
+            const auto& node = drawnNodes.getReference (i);
+            std::array<juce::Point<float>, 3> points { toScreen (node.endPoint),
+                                                       toScreen (node.controlPointOne),
+                                                       toScreen (node.controlPointTwo) };
+            auto numPoints = showsControlPoints (i) ? 3 : 1;
+            region = region.getUnion (juce::Rectangle<float>::findAreaContainingPoints (points.data(), numPoints)
+                                          .expanded (endPointSize * 0.5f + 1.0f));
+        }
+        return region;
     }
-private:
-    juce::ValueTree state;
-    juce::UndoManager& undoManager;
-    juce::OwnedArray<Node> nodes;
-    
-    juce::Point<float> draggingPosition;
-    void onDrag (DraggablePoint* draggablePoint, const juce::MouseEvent& event) override
+    void repaintCrosshair()
     {
-        if (dynamic_cast<EndPoint*> (draggablePoint) != nullptr)
+        if (! isDragging)
+            return;
+        auto cursorPosition = toScreen (draggingPosition).toInt();
+        repaint (cursorPosition.x - 2, 0, 4, getHeight());
+        repaint (0, cursorPosition.y - 2, getWidth(), 4);
+    }
+
+    void dragEndPoint (int index, juce::Point<float> newPosition)
+    {
+        const auto& node = storedNodes.getReference (index);
+        if (index == 0 || index == storedNodes.size() - 1)
         {
-            auto adjustedEvent = event.getEventRelativeTo (this);
-            auto newPosition = scaleFromBounds (adjustedEvent.getPosition().toFloat(), getLocalBounds());
-            if (draggablePoint == &nodes.getFirst()->getEndPoint() || 
-                draggablePoint == &nodes.getLast()->getEndPoint()) 
-            {
-                newPosition.setX (draggablePoint->getPosition().getX());
-            }
-            auto* endPoint = dynamic_cast<EndPoint*> (draggablePoint);
-            auto& node = endPoint->getNode();
-            auto nodeIndex = nodes.indexOf (&node);
-            // bind endpointX to neighboring controlPoints
-            if (nodeIndex > 0 && nodeIndex < nodes.size() - 1)
-            {
-                // make sure endPoint doesn't pass previousNode's controlPoint
-                auto* preceedingNode = nodes[nodeIndex - 1];
-                auto leftBounds = preceedingNode->getEndPoint().getPosition().getX() +
-                                  preceedingNode->getControlPointTwo().getPosition().getX();
-                if (newPosition.getX() < leftBounds) newPosition.setX (leftBounds);
-
-                // make sure currentNode's controlPoint doesn't pass previousNode's endPoint
-                auto leftGapMax = node.getControlPointOne().getPosition().getX();
-                if (newPosition.getX() - preceedingNode->getPosition().getX() < -leftGapMax) 
-                    newPosition.setX (preceedingNode->getPosition().getX() + -leftGapMax);
-                
-                // make sure endPoint doesn't pass proceedingNode's controlPoint
-                auto* proceedingNode = nodes[nodeIndex + 1];
-                auto rightBounds = proceedingNode->getEndPoint().getPosition().getX() + 
-                                   proceedingNode->getControlPointOne().getPosition().getX();
-                if (newPosition.getX() > rightBounds) newPosition.setX (rightBounds);
-
-                //make sure currentNodes' controlPoint doesn't pass proceedingNode's endPoint
-                auto rightGapMax = node.getControlPointTwo().getPosition().getX();
-                if (proceedingNode->getPosition().getX() - newPosition.getX() < rightGapMax)
-                    newPosition.setX (proceedingNode->getPosition().getX() - rightGapMax);
-            }
-            newPosition.x = juce::jlimit (-1.0f, 1.0f, newPosition.getX());
-            newPosition.y = juce::jlimit (-1.0f, 1.0f, newPosition.getY());
-            draggablePoint->setPosition (newPosition);
-            draggingPosition = newPosition;
-            repaint(); 
-        }else if (dynamic_cast<ControlPoint*> (draggablePoint) != nullptr)
+            newPosition.setX (node.endPoint.x);
+        }
+        else
         {
-            auto adjustedEvent = event.getEventRelativeTo (this);
-            auto newPosition = scaleFromBounds (adjustedEvent.getPosition().toFloat(), getLocalBounds());
+            // make sure endPoint doesn't pass previousNode's controlPoint
+            const auto& preceedingNode = storedNodes.getReference (index - 1);
+            if (newPosition.getX() < preceedingNode.controlPointTwo.x) 
+                newPosition.setX (preceedingNode.controlPointTwo.x);
+
+            // make sure currentNode's controlPoint doesn't pass previousNode's endPoint
+            auto leftGap = node.endPoint.x - node.controlPointOne.x;
+            if (newPosition.getX() - preceedingNode.endPoint.x < leftGap) 
+                newPosition.setX (preceedingNode.endPoint.x + leftGap);
             
-            auto* controlPoint = dynamic_cast<ControlPoint*> (draggablePoint);
-            auto& node = controlPoint->getNode();
-            newPosition -= node.getEndPoint().getPosition();
-            // don't allow control points to cross endPointX
-            auto nodeIndex = nodes.indexOf (&node);
-            if (controlPoint == &node.getControlPointOne())
-            {
-                // Don't let controlPoint pass over Endpoint
-                if (newPosition.getX() > 0.0f) newPosition = {0.0f, controlPoint->getPosition().getY()};
-                // Don't let controlPoint pass preceeding EndPoint
-                auto* preceedingNode = nodes[nodeIndex - 1];
-                float leftGapMax = node.getPosition().getX() - preceedingNode->getPosition().getX();
-                if (newPosition.getX() < -leftGapMax)
-                    newPosition = {-leftGapMax, newPosition.getY()};
-                // Don't let mirrored controlPoint pass proceeding endPoint
-                if (nodeIndex < nodes.size() - 1)
-                {
-                    auto* proceedingNode = nodes[nodeIndex + 1];
-                    float rightGapMax = proceedingNode->getPosition().getX() - node.getPosition().getX();
-                    if (-newPosition.getX() > rightGapMax)
-                        newPosition.setX (-rightGapMax);
-                }
-            } else if (controlPoint == &node.getControlPointTwo())
-            { 
-                if (newPosition.getX() < 0.0f) newPosition = {0.0f, controlPoint->getPosition().getY()};
-
-                auto* proceedingNode = nodes[nodeIndex + 1];
-                float rightGapMax = proceedingNode->getPosition().getX() - node.getEndPoint().getPosition().getX();
-                if (newPosition.getX() > rightGapMax)
-                    newPosition = {rightGapMax, newPosition.getY()};
-                
-                if (nodeIndex > 0)
-                {
-                    auto* preceedingNode = nodes[nodeIndex - 1];
-                    float leftGapMax = node.getPosition().getX() - preceedingNode->getPosition().getX();
-                    if (newPosition.getX() > leftGapMax)
-                        newPosition.setX (leftGapMax); 
-                }
-                
-            }
+            // make sure endPoint doesn't pass proceedingNode's controlPoint
+            const auto& proceedingNode = storedNodes.getReference (index + 1);
+            if (newPosition.getX() > proceedingNode.controlPointOne.x) 
+                newPosition.setX (proceedingNode.controlPointOne.x);
 
-            draggablePoint->setPosition (newPosition);
-            draggingPosition = newPosition + node.getEndPoint().getPosition();
-            repaint();         
+            //make sure currentNodes' controlPoint doesn't pass proceedingNode's endPoint
+            auto rightGap = node.controlPointTwo.x - node.endPoint.x;
+            if (proceedingNode.endPoint.x - newPosition.getX() < rightGap)
+                newPosition.setX (proceedingNode.endPoint.x - rightGap);
         }
+        newPosition.x = juce::jlimit (-1.0f, 1.0f, newPosition.getX());
+        newPosition.y = juce::jlimit (-1.0f, 1.0f, newPosition.getY());
+        draggingPosition = newPosition;
+        setPoint (index, id::endPoint, newPosition);
+    }
+    void dragControlPoint (int index, Part part, juce::Point<float> position)
+    {
+        const auto& node = storedNodes.getReference (index);
+        auto newPosition = position - node.endPoint;
+        float leftGapMax = index > 0 ? node.endPoint.x - storedNodes.getReference (index - 1).endPoint.x : 2.0f;
+        float rightGapMax = index < storedNodes.size() - 1 ? storedNodes.getReference (index + 1).endPoint.x - node.endPoint.x : 2.0f;
+
+        // the opposite handle stays in line, keeping the length ratio the
+        // two had when the drag began, so the unequal handles that fitted
+        // and compiled nodes have aren't snapped to the same length
+        const auto& startNode = dragStartNodes.getReference (index);
+        auto startLength = (part == Part::controlPointOne ? startNode.controlPointOne : startNode.controlPointTwo).getDistanceFrom (startNode.endPoint);
+        auto oppositeLength = (part == Part::controlPointOne ? startNode.controlPointTwo : startNode.controlPointOne).getDistanceFrom (startNode.endPoint);
+        auto ratio = startLength > 1.0e-6f ? juce::jmax (1.0e-3f, oppositeLength / startLength) : 1.0f;
+
+        // neither control point may cross its endpoint, nor (mirrored) pass a neighbouring endpoint
+        if (part == Part::controlPointOne)
+        {
+            if (newPosition.getX() > 0.0f) 
+                newPosition = {0.0f, node.controlPointOne.y - node.endPoint.y};
+            newPosition.setX (juce::jmax (newPosition.getX(), -leftGapMax, -rightGapMax / ratio));
+        }
+        else
+        { 
+            if (newPosition.getX() < 0.0f) 
+                newPosition = {0.0f, node.controlPointTwo.y - node.endPoint.y};
+            newPosition.setX (juce::jmin (newPosition.getX(), rightGapMax, leftGapMax / ratio));
+        }
+
+        draggingPosition = newPosition + node.endPoint;
+        auto mirrored = -newPosition * ratio;
+        setPoint (index, part == Part::controlPointOne ? id::controlPoint1 : id::controlPoint2, newPosition);
+        setPoint (index, part == Part::controlPointOne ? id::controlPoint2 : id::controlPoint1, mirrored);
+    }
+    // Drags write the tree directly, and are recorded once they end
+    void setPoint (int index, const juce::Identifier& type, juce::Point<float> position)
+    {
+        auto pointBranch = state.getChild (index).getChildWithName (type);
+        pointBranch.setProperty (id::x, position.x, nullptr);
+        pointBranch.setProperty (id::y, position.y, nullptr);
+    }
+    // A whole drag is one undo step, holding only the nodes it changed. A
+    // drag of the same node started soon after the last one ended joins
+    // its step, so nudging a node into place undoes in one go.
+    void recordDrag()
+    {
+        static const juce::String description ("Point Dragged");
+        static constexpr juce::uint32 joinMilliseconds = 500;
+
+        auto edit = std::make_unique<CurveEdit> (state, dragStartNodes, CurvePositionCalculator::readNodes (state));
+        if (edit->isEmpty())
+            return;
+
+        auto joinsLast = dragged.node == lastDraggedNode
+                      && dragStartTime - lastDragTime < joinMilliseconds
+                      && ! undoManager.canRedo()
+                      && undoManager.getUndoDescription() == description;
+        if (! joinsLast)
+            undoManager.beginNewTransaction (description);
+        undoManager.perform (edit.release());
+        lastDraggedNode = dragged.node;
+        lastDragTime = juce::Time::getMillisecondCounter();
     }
-    void onDragEnd() override { repaint(); }
+    void showSegmentTypeMenu (int index)
+    {
+        juce::PopupMenu menu;
+        auto currentType = static_cast<int> (storedNodes.getReference (index).type);
+        for (int i = 0; i < segmentTypeNames.size(); i++)
+            menu.addItem (i + 1, segmentTypeNames[i], true, i == currentType);
+
+        auto nodeBranch = state.getChild (index);
+        auto area = localAreaToGlobal (getHandleBounds ({index, Part::endPoint}).getSmallestIntegerContainer());
+        juce::Component::SafePointer<Curve> safeThis (this);
+        menu.showMenuAsync (juce::PopupMenu::Options().withTargetScreenArea (area), [safeThis, nodeBranch](int result) mutable
+            {
+                if (safeThis == nullptr || result <= 0)
+                    return;
+                safeThis->undoManager.beginNewTransaction ("Segment Type Changed");
+                nodeBranch.setProperty (id::segmentType, result - 1, &safeThis->undoManager);
+            });
+    }
+
     void resetNodes()
     {
-        removeAllChildren();
-        nodes.clear();
+        cancelPendingUpdate();
+        pendingNodes = {};
+        needsReset = false;
+        storedNodes.clearQuick();
+        storedNodes.ensureStorageAllocated (state.getNumChildren());
+        for (const auto& nodeBranch : state)
+            storedNodes.add (CurvePositionCalculator::readNode (nodeBranch));
+        drawnNodes.clearQuick();
+        drawnNodes.addArray (storedNodes);
+        CurvePositionCalculator::resolveSegmentTypes (drawnNodes);
+        updateOutlines ({0, drawnNodes.size() - 1});
 
-        for (int i = 0; i < state.getNumChildren(); i++)
-            addAndMakeVisible (nodes.add (new Node (state.getChild (i), undoManager)));
-        
-        for (auto* n : nodes)
-            n->addListener (this);
+        hovered = {};
+        dragged = {};
+        isDragging = false;
+        repaint();
+    }
+    // A node's derived control points depend on its neighbours, so moving one
+    // node recompiles three, and redraws the four segments they touch
+    void updateNodes (juce::Range<int> changed)
+    {
+        juce::Range<int> nodeRange (juce::jmax (0, changed.getStart() - 1), 
+                                    juce::jmin (drawnNodes.size(), changed.getEnd() + 1));
+        juce::Range<int> segments (juce::jmax (0, changed.getStart() - 2), 
+                                   juce::jmin (drawnNodes.size() - 1, changed.getEnd() + 1));
+        auto dirty = getRegion (nodeRange, segments);
+
+        for (int i = changed.getStart(); i < changed.getEnd(); i++)
+            storedNodes.set (i, CurvePositionCalculator::readNode (state.getChild (i)));
+        for (int i = nodeRange.getStart(); i < nodeRange.getEnd(); i++)
+            drawnNodes.set (i, storedNodes.getReference (i));
+        CurvePositionCalculator::resolveSegmentTypes (drawnNodes, nodeRange);
+        updateOutlines (segments);
+
+        repaint (dirty.getUnion (getRegion (nodeRange, segments)).getSmallestIntegerContainer());
     }
     void valueTreePropertyChanged (juce::ValueTree& tree,
                                    const juce::Identifier& property) override 
     {
-        juce::ignoreUnused (tree, property);
+        juce::ignoreUnused (property);
+        if (tree == state || needsReset)
+            return;
+        // the dragged node is almost always the one that changed
+        auto nodeBranch = tree.getType() == id::NODE ? tree : tree.getParent();
+        auto index = dragged.node >= 0 && state.getChild (dragged.node) == nodeBranch ? dragged.node
+                                                                                      : state.indexOf (nodeBranch);
+        if (index < 0 || index >= storedNodes.size())
+            return;
 
-        if (property == id::presetIndex)
-        {
-            copyPresetToActive (static_cast<int> (tree.getProperty (property)));
+        juce::Range<int> changed (index, index + 1);
+        pendingNodes = pendingNodes.isEmpty() ? changed : pendingNodes.getUnionWith (changed);
+        triggerAsyncUpdate();
+    }
+    void handleAsyncUpdate() override
+    {
+        if (needsReset)
             resetNodes();
-        }
-        repaint();resized();
+        else if (! pendingNodes.isEmpty())
+            updateNodes (pendingNodes);
+        pendingNodes = {};
     }
-
-    void copyPresetToActive (int presetIndex)
+    // Replacing a curve adds and removes nodes one at a time, so the nodes
+    // are read again once it's done rather than after each one
+    void structureChanged (juce::ValueTree& parentTree)
     {
-        state.removeAllChildren(nullptr);
-        auto presetBranch = state.getParent().getChildWithName (id::PRESETS);
-        auto curveBranch = presetBranch.getChild (presetIndex);
-        std::cout << curveBranch.toXmlString();
-        std::cout << curveBranch.getNumChildren();
-        for (int i = 0; i < curveBranch.getNumChildren(); i++)
-            state.addChild (curveBranch.getChild (i).createCopy(), -1, nullptr);
-
-        // std::cout << state.toXmlString();
+        if (parentTree != state)
+            return;
+        needsReset = true;
+        triggerAsyncUpdate();
+    }
+    void valueTreeChildAdded (juce::ValueTree& parentTree,
+                              juce::ValueTree& childWhichHasBeenAdded) override
+    {
+        juce::ignoreUnused (childWhichHasBeenAdded);
+        structureChanged (parentTree);
+    }
+    void valueTreeChildRemoved (juce::ValueTree& parentTree,
+                                juce::ValueTree& childWhichHasBeenRemoved, 
+                                int indexFromWhichChildWasRemoved) override
+    {
+        juce::ignoreUnused (childWhichHasBeenRemoved, indexFromWhichChildWasRemoved);
+        structureChanged (parentTree);
+    }
+    void valueTreeChildOrderChanged (juce::ValueTree& parentTree, int oldIndex, int newIndex) override
+    {
+        juce::ignoreUnused (oldIndex, newIndex);
+        structureChanged (parentTree);
     }
 };
 
 class CurveHeader : public juce::Component, 
-                    private juce::ValueTree::Listener
+                    private juce::ValueTree::Listener,
+                    private juce::ChangeListener
 {
 public:
-    CurveHeader(juce::ValueTree curveBranch, juce::UndoManager& um)
+    CurveHeader(juce::ValueTree curveBranch, juce::UndoManager& um, PresetLibrary& presetLibrary)
       : presetBranch (curveBranch.getChildWithName (id::PRESETS)),
         activeCurveBranch (curveBranch.getChildWithName (id::ACTIVE_CURVE)), 
-        undoManager (um)
+        undoManager (um),
+        library (presetLibrary)
     {
         jassert (curveBranch.getType() == id::CURVE);
 
         presetBranch.addListener (this);
+        activeCurveBranch.addListener (this);
+        library.addChangeListener (this);
 
-        for (int i = 0; i < presetBranch.getNumChildren(); i++)
-            presets.addItem (presetBranch.getChild (i).getProperty (id::name).toString(), i + 1);
-        
-        presets.setSelectedItemIndex (static_cast<int> (activeCurveBranch.getProperty (id::presetIndex)));
-        presets.onChange = [&](){ activeCurveBranch.setProperty (id::presetIndex, presets.getSelectedItemIndex(), &undoManager); };
+        updatePresetList();
+        presets.onChange = [&]()
+            { 
+                auto itemId = presets.getSelectedId();
+                if (itemId >= libraryItemId)
+                {
+                    selectLibraryCurve (itemId - libraryItemId);
+                }
+                else if (itemId > 0 && itemId - 1 != static_cast<int> (activeCurveBranch.getProperty (id::presetIndex)))
+                {
+                    undoManager.beginNewTransaction ("Preset Selected");
+                    selectPreset (itemId - 1);
+                }
+                updateScanButton();
+            };
+        presets.onShowPopup = [&]() { listLibrary(); };
         addAndMakeVisible (presets);
 
+        scanButton.setTooltip ("Include this curve in the curve scan. With none included, every curve is scanned.");
+        scanButton.onClick = [&]()
+            {
+                auto preset = getSelectedPreset();
+                if (preset.isValid())
+                    preset.setProperty (id::inScan, scanButton.getToggleState(), &undoManager);
+            };
+        updateScanButton();
+        addAndMakeVisible (scanButton);
+
+        designButton.setClickingTogglesState (true);
+        designButton.onClick = [&]()
+            {
+                if (onDesignModeChanged != nullptr)
+                    onDesignModeChanged (designButton.getToggleState());
+            };
+        addAndMakeVisible (designButton);
+
+        captureButton.setTooltip ("Fit a curve to a dry recording and the same recording processed");
+        captureButton.onClick = [&](){ chooseCaptureFiles(); };
+        addAndMakeVisible (captureButton);
+
+        shapeButton.setTooltip ("Normalize, mirror, resample or smooth the whole active curve");
+        shapeButton.onClick = [&](){ showShapeMenu(); };
+        addAndMakeVisible (shapeButton);
+
+        fileButton.setTooltip ("Import a curve from CSV samples or a curve file, or export the active curve");
+        fileButton.onClick = [&](){ showFileMenu(); };
+        addAndMakeVisible (fileButton);
+
         saveButton.onClick = [&]()
             { 
                 auto laf = dynamic_cast<OriotoLookAndFeel*> (&getLookAndFeel());
@@ -454,21 +608,312 @@ public:
             };
         addAndMakeVisible (saveButton);
     }
+    ~CurveHeader() override
+    {
+        library.removeChangeListener (this);
+    }
     void resized() override 
     {
         auto b = getLocalBounds();
         b.removeFromBottom (2);
         int unitWidth = static_cast<int> (b.getWidth() / 3.0f);
-        presets.setBounds (b.removeFromLeft (unitWidth));
+        presets.setBounds (b.removeFromLeft (unitWidth - unitWidth / 3));
         saveButton.setBounds (b.removeFromLeft (unitWidth / 3));
+        scanButton.setBounds (b.removeFromLeft (unitWidth / 3));
+        captureButton.setBounds (b.removeFromLeft (unitWidth / 3));
+        shapeButton.setBounds (b.removeFromLeft (unitWidth / 3));
+        fileButton.setBounds (b.removeFromLeft (unitWidth / 3));
+        designButton.setBounds (b.removeFromRight (unitWidth / 2));
+    }
+    std::function<void (bool)> onDesignModeChanged;
+    // The library is only listed once someone looks at it, when the list
+    // is about to show
+    void listLibrary()
+    {
+        library.refresh();
+        libraryRequested = true;
+        if (listedLibraryVersion != library.getVersion())
+            updatePresetList();
     }
 private:
     juce::ValueTree presetBranch;
     juce::ValueTree activeCurveBranch;
     juce::UndoManager& undoManager;
+    PresetLibrary& library;
 
-    juce::ComboBox presets;
+    // Session presets have ids from 1, library entries from libraryItemId
+    struct PresetBox : public juce::ComboBox
+    {
+        std::function<void()> onShowPopup;
+        void showPopup() override
+        {
+            if (onShowPopup != nullptr)
+                onShowPopup();
+            juce::ComboBox::showPopup();
+        }
+    };
+    static constexpr int libraryItemId = 1 << 20;
+    PresetBox presets;
+    bool libraryRequested = false;
+    int listedLibraryVersion = -1;
     juce::TextButton saveButton {"New"};
+    juce::ToggleButton scanButton {"Scan"};
+    juce::TextButton designButton {"Harmonics"};
+    juce::TextButton captureButton {"Capture"};
+    juce::TextButton shapeButton {"Shape"};
+    juce::TextButton fileButton {"File"};
+
+    std::unique_ptr<juce::FileChooser> fileChooser;
+    std::unique_ptr<CurveCapture> curveCapture;
+
+    void chooseCaptureFiles()
+    {
+        auto flags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+        fileChooser.reset (new juce::FileChooser ("Select the dry recording", {}, "*.wav;*.aif;*.aiff;*.flac"));
+        fileChooser->launchAsync (flags, [this, flags](const juce::FileChooser& dryChooser)
+            {
+                auto dry = dryChooser.getResult();
+                if (! dry.existsAsFile())
+                    return;
+
+                fileChooser.reset (new juce::FileChooser ("Select the processed recording", dry.getParentDirectory(), "*.wav;*.aif;*.aiff;*.flac"));
+                fileChooser->launchAsync (flags, [this, dry](const juce::FileChooser& processedChooser)
+                    {
+                        auto processed = processedChooser.getResult();
+                        if (processed.existsAsFile())
+                            startCapture (dry, processed);
+                    });
+            });
+    }
+    void startCapture (juce::File dry, juce::File processed)
+    {
+        captureButton.setEnabled (false);
+        juce::Component::SafePointer<CurveHeader> safeThis (this);
+        curveCapture.reset (new CurveCapture (dry, processed, [safeThis](const CurveCapture::Result& result)
+            {
+                if (safeThis != nullptr)
+                    safeThis->finishCapture (result);
+            }));
+    }
+    void finishCapture (const CurveCapture::Result& result)
+    {
+        curveCapture.reset();
+        captureButton.setEnabled (true);
+        if (result.error.isNotEmpty())
+        {
+            juce::AlertWindow::showMessageBoxAsync (juce::MessageBoxIconType::WarningIcon, "Capture Failed", result.error);
+            return;
+        }
+        juce::ValueTree curveBranch (id::CURVE);
+        curveBranch.setProperty (id::name, result.name, nullptr);
+        CurveBranch::setNodes (curveBranch, result.nodes, nullptr);
+        undoManager.beginNewTransaction ("Capture Curve");
+        addPreset (curveBranch);
+    }
+
+    void showShapeMenu()
+    {
+        juce::PopupMenu menu;
+        menu.addItem ("Normalize", [this](){ applyToCurve ("Normalize Curve", CurveOperations::normalize); });
+        menu.addItem ("Make Odd-Symmetric", [this](){ applyToCurve ("Make Curve Odd-Symmetric", CurveOperations::makeOddSymmetric); });
+        menu.addItem ("Mirror Horizontally", [this](){ applyToCurve ("Mirror Curve", CurveOperations::mirrorHorizontally); });
+        menu.addItem ("Mirror Vertically", [this](){ applyToCurve ("Mirror Curve", CurveOperations::mirrorVertically); });
+        menu.addItem ("Smooth", [this](){ applyToCurve ("Smooth Curve", CurveOperations::smooth); });
+
+        // odd counts keep a node at the centre
+        juce::PopupMenu resampleMenu;
+        for (auto numNodes : {5, 9, 17, 33, 65, 129, 257, 1025})
+            resampleMenu.addItem (juce::String (numNodes) + " Nodes", [this, numNodes]()
+                {
+                    applyToCurve ("Resample Curve", [numNodes](const juce::Array<Node>& nodes) 
+                        { 
+                            return CurveOperations::resample (nodes, numNodes); 
+                        });
+                });
+        menu.addSubMenu ("Resample", resampleMenu);
+        menu.showMenuAsync (juce::PopupMenu::Options().withTargetComponent (shapeButton));
+    }
+    // Rewrites the active curve as one undo step, which the transfer
+    // function compiles once
+    void applyToCurve (const juce::String& transactionName, 
+                       const std::function<juce::Array<Node> (const juce::Array<Node>&)>& operation)
+    {
+        auto nodes = CurvePositionCalculator::readNodes (activeCurveBranch);
+        if (nodes.size() < 2)
+            return;
+        undoManager.beginNewTransaction (transactionName);
+        CurveBranch::setNodes (activeCurveBranch, operation (nodes), &undoManager);
+    }
+    void showFileMenu()
+    {
+        juce::PopupMenu menu;
+        menu.addItem ("Import...", [this](){ chooseImportFile(); });
+        menu.addItem ("Export as CSV...", [this](){ chooseExportFile ("*.csv", ".csv"); });
+        menu.addItem ("Export as Curve File...", [this](){ chooseExportFile ("*.oriotocurve", CurveFile::curveExtension); });
+        menu.addSeparator();
+        menu.addItem ("Add to Library...", [this](){ chooseLibraryName(); });
+        menu.showMenuAsync (juce::PopupMenu::Options().withTargetComponent (fileButton));
+    }
+    void chooseImportFile()
+    {
+        auto flags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+        fileChooser.reset (new juce::FileChooser ("Import a curve", {}, CurveFile::wildcard));
+        fileChooser->launchAsync (flags, [this](const juce::FileChooser& chooser)
+            {
+                auto file = chooser.getResult();
+                if (! file.existsAsFile())
+                    return;
+
+                // the curve is built detached, then added in one step
+                juce::ValueTree curveBranch;
+                auto error = CurveFile::read (file, curveBranch);
+                if (error.isNotEmpty())
+                {
+                    juce::AlertWindow::showMessageBoxAsync (juce::MessageBoxIconType::WarningIcon, "Import Failed", error);
+                    return;
+                }
+                undoManager.beginNewTransaction ("Import Curve");
+                addPreset (curveBranch);
+            });
+    }
+    void chooseExportFile (const juce::String& pattern, const juce::String& extension)
+    {
+        auto name = getSelectedName();
+        auto flags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting;
+        fileChooser.reset (new juce::FileChooser ("Export the active curve", juce::File::getSpecialLocation (juce::File::userDocumentsDirectory).getChildFile (name + extension), pattern));
+        fileChooser->launchAsync (flags, [this, name, extension](const juce::FileChooser& chooser)
+            {
+                auto file = chooser.getResult();
+                if (file == juce::File())
+                    return;
+
+                if (! CurveFile::write (activeCurveBranch, name, file.withFileExtension (extension)))
+                    juce::AlertWindow::showMessageBoxAsync (juce::MessageBoxIconType::WarningIcon, "Export Failed", 
+                                                            "Could not write " + file.getFullPathName());
+            });
+    }
+
+    // The preset list is rebuilt whenever presets come or go or are renamed,
+    // and follows the active curve's presetIndex, without either counting as
+    // a selection by the user. Library entries are grouped by their first tag.
+    void updatePresetList()
+    {
+        presets.clear (juce::dontSendNotification);
+        for (int i = 0; i < presetBranch.getNumChildren(); i++)
+            presets.addItem (presetBranch.getChild (i).getProperty (id::name).toString(), i + 1);
+
+        if (libraryRequested && library.getNumEntries() > 0)
+        {
+            presets.addSectionHeading ("Library");
+            std::map<juce::String, juce::PopupMenu> tagged;
+            for (int i = 0; i < library.getNumEntries(); i++)
+            {
+                auto tags = library.getTags (i);
+                if (tags.isEmpty())
+                    presets.addItem (library.getName (i), libraryItemId + i);
+                else
+                    tagged[tags[0]].addItem (libraryItemId + i, library.getName (i));
+            }
+            for (auto& group : tagged)
+                presets.getRootMenu()->addSubMenu (group.first, group.second);
+            listedLibraryVersion = library.getVersion();
+        }
+
+        auto presetIndex = static_cast<int> (activeCurveBranch.getProperty (id::presetIndex));
+        if (presetIndex >= 0)
+        {
+            presets.setSelectedId (presetIndex + 1, juce::dontSendNotification);
+        }
+        else
+        {
+            auto entry = library.indexOf (static_cast<juce::int64> (activeCurveBranch.getProperty (id::libraryHash)));
+            if (entry >= 0 && libraryRequested)
+                presets.setSelectedId (libraryItemId + entry, juce::dontSendNotification);
+            else
+                presets.setText (entry >= 0 ? library.getName (entry) : juce::String(), juce::dontSendNotification);
+        }
+        updateScanButton();
+    }
+    juce::ValueTree getSelectedPreset() const { return presetBranch.getChild (presets.getSelectedId() - 1); }
+    juce::String getSelectedName() const
+    {
+        auto text = presets.getText();
+        return getSelectedPreset().getProperty (id::name, text.isNotEmpty() ? text : "Curve").toString();
+    }
+    // Copies a preset's nodes into the active curve, in place when the node
+    // counts match. The caller begins the undo transaction.
+    void selectPreset (int index)
+    {
+        auto curveBranch = presetBranch.getChild (index);
+        if (! curveBranch.isValid())
+            return;
+
+        activeCurveBranch.setProperty (id::presetIndex, index, &undoManager);
+        activeCurveBranch.removeProperty (id::libraryHash, &undoManager);
+        CurveBranch::setNodes (activeCurveBranch, CurvePositionCalculator::readNodes (curveBranch), &undoManager);
+    }
+    // Library curves are copied into the active curve alone, so they aren't
+    // duplicated into the session's presets
+    void selectLibraryCurve (int entry)
+    {
+        auto hash = library.getHash (entry);
+        if (static_cast<int> (activeCurveBranch.getProperty (id::presetIndex)) < 0
+            && static_cast<juce::int64> (activeCurveBranch.getProperty (id::libraryHash)) == hash)
+            return;
+
+        auto curveBranch = library.loadCurve (entry);
+        if (! curveBranch.isValid())
+        {
+            updatePresetList();
+            juce::AlertWindow::showMessageBoxAsync (juce::MessageBoxIconType::WarningIcon, "Library Curve Damaged",
+                                                    "The curve could not be read from the library.");
+            return;
+        }
+        undoManager.beginNewTransaction ("Library Curve Selected");
+        activeCurveBranch.setProperty (id::presetIndex, -1, &undoManager);
+        activeCurveBranch.setProperty (id::libraryHash, hash, &undoManager);
+        CurveBranch::setNodes (activeCurveBranch, CurvePositionCalculator::readNodes (curveBranch), &undoManager);
+    }
+    void chooseLibraryName()
+    {
+        auto* window = new juce::AlertWindow ("Add to Library", "Save the active curve to the library shared by every session.",
+                                              juce::MessageBoxIconType::NoIcon, this);
+        window->addTextEditor ("name", getSelectedName(), "Name");
+        window->addTextEditor ("tags", {}, "Tags, separated by commas");
+        window->addButton ("Add", 1, juce::KeyPress (juce::KeyPress::returnKey));
+        window->addButton ("Cancel", 0, juce::KeyPress (juce::KeyPress::escapeKey));
+
+        juce::Component::SafePointer<CurveHeader> safeThis (this);
+        window->enterModalState (true, juce::ModalCallbackFunction::create ([safeThis, window](int result)
+            {
+                if (safeThis == nullptr || result != 1)
+                    return;
+                auto name = window->getTextEditorContents ("name").trim();
+                auto tags = juce::StringArray::fromTokens (window->getTextEditorContents ("tags"), ",", {});
+                tags.trim();
+                tags.removeEmptyStrings();
+                if (safeThis->library.add (safeThis->activeCurveBranch, name.isNotEmpty() ? name : "Curve", tags) < 0)
+                    juce::AlertWindow::showMessageBoxAsync (juce::MessageBoxIconType::WarningIcon, "Add to Library Failed",
+                                                            "Could not write the library file.");
+            }), true);
+    }
+    void changeListenerCallback (juce::ChangeBroadcaster* source) override
+    {
+        juce::ignoreUnused (source);
+        if (libraryRequested)
+            updatePresetList();
+    }
+    void addPreset (juce::ValueTree curveBranch)
+    {
+        presetBranch.addChild (curveBranch, -1, &undoManager);
+        selectPreset (presetBranch.getNumChildren() - 1);
+    }
+
+    void updateScanButton()
+    {
+        auto preset = getSelectedPreset();
+        scanButton.setToggleState (static_cast<bool> (preset.getProperty (id::inScan, false)), juce::dontSendNotification);
+    }
 
     void closeNewCurveWindow()
     {
@@ -519,7 +964,8 @@ private:
        juce::ignoreUnused (name, numPoints);
        auto newTree = generateBypassCurve (numPoints);
        newTree.setProperty (id::name, name, nullptr);
-       presetBranch.addChild (newTree, -1, nullptr);
+       undoManager.beginNewTransaction ("New Curve");
+       addPreset (newTree);
     }
     struct NewCurveWindow : public juce::DocumentWindow
     {
@@ -565,20 +1011,28 @@ private:
     };
     std::unique_ptr<juce::DocumentWindow> newCurveWindow;
 
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override
+    {
+        if ((tree == activeCurveBranch && (property == id::presetIndex || property == id::libraryHash))
+            || (tree.getParent() == presetBranch && property == id::name))
+            updatePresetList();
+        else if (tree.getParent() == presetBranch && property == id::inScan)
+            updateScanButton();
+    }
     void valueTreeChildAdded (juce::ValueTree& parentTree,
                               juce::ValueTree& childWhichHasBeenAdded) override
     {
-        if (parentTree.getType() == id::PRESETS)
-        {
-            presets.clear();
-            for (int i = 0; i < presetBranch.getNumChildren(); i++)
-            {
-                auto name = presetBranch.getChild (i).getProperty (id::name).toString();
-                presets.addItem (name, i + 1);
-                if (name == childWhichHasBeenAdded.getProperty (id::name).toString())
-                    presets.setSelectedItemIndex (i);
-            }
-        }
+        juce::ignoreUnused (childWhichHasBeenAdded);
+        if (parentTree == presetBranch)
+            updatePresetList();
+    }
+    void valueTreeChildRemoved (juce::ValueTree& parentTree,
+                                juce::ValueTree& childWhichHasBeenRemoved,
+                                int indexFromWhichChildWasRemoved) override
+    {
+        juce::ignoreUnused (childWhichHasBeenRemoved, indexFromWhichChildWasRemoved);
+        if (parentTree == presetBranch)
+            updatePresetList();
     }
 
 };
@@ -588,21 +1042,32 @@ class CurveEditor : public juce::Component
 public:
     CurveEditor (juce::ValueTree curveBranch, juce::UndoManager& um)
       : curve (curveBranch.getChildWithName (id::ACTIVE_CURVE), um), 
-        header (curveBranch, um)
+        header (curveBranch, um, *library), 
+        harmonicDesigner (curveBranch, um)
     {
         jassert (curveBranch.getType() == id::CURVE);
         addAndMakeVisible (header);
         addAndMakeVisible (curve);
+        addChildComponent (harmonicDesigner);
+
+        header.onDesignModeChanged = [&](bool designing)
+            {
+                curve.setVisible (! designing);
+                harmonicDesigner.setVisible (designing);
+            };
     }
     void resized() override 
     {
         auto b = getLocalBounds();
         header.setBounds (b.removeFromTop (30));
         curve.setBounds (b);
+        harmonicDesigner.setBounds (b);
     }
 
 private:
+    juce::SharedResourcePointer<PresetLibrary> library;
     CurveHeader header;
     Curve curve;
+    HarmonicDesigner harmonicDesigner;
 };
 }
\ No newline at end of file
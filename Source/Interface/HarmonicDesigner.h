@@ -0,0 +1,96 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include "../Identifiers.h"
+#include "../DefaultTreeGenerator.h"
+#include "../ChebyshevCurve.h"
+#include "LookAndFeel.hpp"
+
+namespace oi
+{
+class HarmonicDesigner : public juce::Component,
+                         private juce::ValueTree::Listener
+{
+public:
+    HarmonicDesigner (juce::ValueTree curveBranch, juce::UndoManager& um)
+      : harmonicsBranch (curveBranch.getOrCreateChildWithName (id::HARMONICS, nullptr)),
+        activeCurveBranch (curveBranch.getChildWithName (id::ACTIVE_CURVE)),
+        undoManager (um)
+    {
+        jassert (curveBranch.getType() == id::CURVE);
+        harmonicsBranch.addListener (this);
+
+        for (int k = ChebyshevCurve::firstHarmonic; k <= ChebyshevCurve::lastHarmonic; k++)
+        {
+            auto* slider = sliders.add (new juce::Slider (juce::Slider::SliderStyle::LinearBarVertical,
+                                                          juce::Slider::TextEntryBoxPosition::NoTextBox));
+            slider->setRange (-1.0, 1.0);
+            slider->setDoubleClickReturnValue (true, 0.0);
+            auto harmonic = ChebyshevCurve::getHarmonicIdentifier (k);
+            slider->setValue (harmonicsBranch.getProperty (harmonic, 0.0), juce::dontSendNotification);
+            slider->onDragStart = [this]()
+                {
+                    dragging = true;
+                    undoManager.beginNewTransaction ("Harmonics Changed");
+                };
+            slider->onDragEnd = [this]() { dragging = false; };
+            // the tree is written here rather than through the slider's
+            // value, so a change outside a drag (a double-click reset or
+            // the mouse wheel) can begin its own transaction first
+            slider->onValueChange = [this, slider, harmonic]()
+                {
+                    if (! dragging)
+                        undoManager.beginNewTransaction ("Harmonics Changed");
+                    harmonicsBranch.setProperty (harmonic, slider->getValue(), &undoManager);
+                    applyToActiveCurve();
+                };
+            addAndMakeVisible (slider);
+
+            auto* label = labels.add (new juce::Label ({}, juce::String (k)));
+            label->setJustificationType (juce::Justification::centred);
+            addAndMakeVisible (label);
+        }
+    }
+    void paint (juce::Graphics& g) override
+    {
+        auto laf = dynamic_cast<OriotoLookAndFeel*> (&getLookAndFeel());
+        jassert (laf != nullptr);
+        g.fillAll (laf->getBaseColour());
+    }
+    void resized() override
+    {
+        auto b = getLocalBounds().reduced (4);
+        auto labelBounds = b.removeFromBottom (20);
+        auto unitWidth = b.getWidth() / sliders.size();
+        for (int i = 0; i < sliders.size(); i++)
+        {
+            sliders[i]->setBounds (b.removeFromLeft (unitWidth).reduced (2, 0));
+            labels[i]->setBounds (labelBounds.removeFromLeft (unitWidth));
+        }
+    }
+    // Replaces the active curve with the fit of the current harmonic amplitudes
+    void applyToActiveCurve()
+    {
+        auto nodes = ChebyshevCurve::fit (ChebyshevCurve::getAmplitudes (harmonicsBranch));
+        CurveBranch::setNodes (activeCurveBranch, nodes, &undoManager);
+    }
+private:
+    juce::ValueTree harmonicsBranch;
+    juce::ValueTree activeCurveBranch;
+    juce::UndoManager& undoManager;
+
+    juce::OwnedArray<juce::Slider> sliders;
+    juce::OwnedArray<juce::Label> labels;
+    bool dragging = false;
+
+    // Follows undo, redo and loaded states
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property) override
+    {
+        if (tree != harmonicsBranch)
+            return;
+        for (int k = ChebyshevCurve::firstHarmonic; k <= ChebyshevCurve::lastHarmonic; k++)
+            if (property == ChebyshevCurve::getHarmonicIdentifier (k))
+                sliders[k - ChebyshevCurve::firstHarmonic]->setValue (tree.getProperty (property, 0.0), juce::dontSendNotification);
+    }
+};
+}
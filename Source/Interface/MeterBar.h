@@ -0,0 +1,82 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include "LookAndFeel.hpp"
+
+namespace oi
+{
+/** A vertical meter. Levels fill up from the bottom, RMS as a bar with the
+    peak as a line above it; gain reduction fills down from the top. Values
+    rise at once and fall back at a fixed rate, and it only repaints when
+    that moves it by a pixel or more.
+*/
+class MeterBar : public juce::Component
+{
+public:
+    enum class Style { level, gainReduction };
+
+    MeterBar (Style s = Style::level)
+      : style (s)
+    {
+        setOpaque (true);
+    }
+    // Called once per frame, in decibels
+    void setLevels (float rmsDecibels, float peakDecibels)
+    {
+        rms = fall (rms, rmsDecibels);
+        peak = fall (peak, peakDecibels);
+
+        auto newRmsPosition = toPosition (rms);
+        auto newPeakPosition = toPosition (peak);
+        if (newRmsPosition != rmsPosition || newPeakPosition != peakPosition)
+        {
+            rmsPosition = newRmsPosition;
+            peakPosition = newPeakPosition;
+            repaint();
+        }
+    }
+    void setGainReduction (float decibels) { setLevels (-decibels, -decibels); }
+
+    void paint (juce::Graphics& g) override
+    {
+        auto laf = dynamic_cast<OriotoLookAndFeel*> (&getLookAndFeel());
+        jassert (laf != nullptr);
+        g.fillAll (laf->getBackgroundColour().darker (1.0f));
+
+        auto b = getLocalBounds();
+        g.setColour (laf->getAccentColour());
+        if (style == Style::gainReduction)
+        {
+            g.fillRect (b.removeFromTop (rmsPosition));
+            return;
+        }
+        g.fillRect (b.withTrimmedTop (getHeight() - rmsPosition));
+        g.fillRect (b.getX(), getHeight() - peakPosition, b.getWidth(), 1);
+    }
+private:
+    static constexpr float levelRange = 60.0f;
+    static constexpr float gainReductionRange = 24.0f;
+    static constexpr float fallPerFrame = 1.5f;
+
+    Style style;
+    // decibels below 0 dB for levels, of reduction for gain reduction
+    float rms = -levelRange;
+    float peak = -levelRange;
+    int rmsPosition = 0;
+    int peakPosition = 0;
+
+    float fall (float current, float target) const
+    {
+        if (style == Style::gainReduction)
+            return target > current ? target : juce::jmax (target, current - fallPerFrame);
+        return target > current ? target : juce::jmax (target, current - fallPerFrame, -levelRange);
+    }
+    // Height of the bar in pixels
+    int toPosition (float decibels) const
+    {
+        auto proportion = style == Style::gainReduction ? decibels / gainReductionRange
+                                                        : (decibels + levelRange) / levelRange;
+        return juce::roundToInt (juce::jlimit (0.0f, 1.0f, proportion) * static_cast<float> (getHeight()));
+    }
+};
+}
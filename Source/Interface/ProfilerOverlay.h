@@ -0,0 +1,87 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include "../DSP/StageProfiler.h"
+
+namespace oi
+{
+/** Debug readout of the processor's StageProfiler, for builds made with
+    ORIOTO_PROFILING. Right click to save the figures as JSON or reset them.
+*/
+class ProfilerOverlay : public juce::Component,
+                        private juce::Timer
+{
+public:
+    ProfilerOverlay (op::StageProfiler& p)
+      : profiler (p)
+    {
+        startTimerHz (refreshRate);
+    }
+    void paint (juce::Graphics& g) override
+    {
+        g.fillAll (juce::Colours::black.withAlpha (0.75f));
+        g.setColour (juce::Colours::white);
+        g.setFont (12.0f);
+
+        auto b = getLocalBounds().reduced (4);
+        auto drawRow = [&](const juce::String& name, const juce::String& p50, const juce::String& p99, const juce::String& max)
+        {
+            auto row = b.removeFromTop (rowHeight);
+            auto columnWidth = row.getWidth() / 5;
+            g.drawText (name, row.removeFromLeft (2 * columnWidth), juce::Justification::centredLeft);
+            g.drawText (p50, row.removeFromLeft (columnWidth), juce::Justification::centredRight);
+            g.drawText (p99, row.removeFromLeft (columnWidth), juce::Justification::centredRight);
+            g.drawText (max, row, juce::Justification::centredRight);
+        };
+        auto format = [](double value) { return juce::String (value, 1); };
+
+        drawRow ("us", "p50", "p99", "max");
+        for (size_t i = 0; i < report.stages.size(); i++)
+        {
+            const auto& stage = report.stages[i];
+            drawRow (op::StageProfiler::stageNames[i], format (stage.p50), format (stage.p99), format (stage.max));
+        }
+        drawRow ("Load %", format (report.load.p50), format (report.load.p99), format (report.load.max));
+        drawRow (juce::String (report.numBlocks) + " blocks", {}, {}, {});
+    }
+    int getIdealHeight() const { return 8 + rowHeight * (op::StageProfiler::numStages + 3); }
+
+    void mouseDown (const juce::MouseEvent& event) override
+    {
+        if (! event.mods.isPopupMenu())
+            return;
+
+        juce::PopupMenu menu;
+        menu.addItem ("Save as JSON...", [this]() { saveJson(); });
+        menu.addItem ("Reset", [this]() { profiler.reset(); });
+        menu.showMenuAsync (juce::PopupMenu::Options().withTargetComponent (this));
+    }
+private:
+    static constexpr int refreshRate = 4;
+    static constexpr int rowHeight = 16;
+
+    op::StageProfiler& profiler;
+    op::StageProfiler::Report report;
+    std::unique_ptr<juce::FileChooser> fileChooser;
+
+    void timerCallback() override
+    {
+        report = profiler.getReport();
+        repaint();
+    }
+    void saveJson()
+    {
+        auto json = op::StageProfiler::toJson (profiler.getReport());
+        auto flags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting;
+        fileChooser.reset (new juce::FileChooser ("Save the profile",
+                                                  juce::File::getSpecialLocation (juce::File::userDocumentsDirectory).getChildFile ("Orioto Profile.json"),
+                                                  "*.json"));
+        fileChooser->launchAsync (flags, [json](const juce::FileChooser& chooser)
+            {
+                auto file = chooser.getResult();
+                if (file != juce::File())
+                    file.withFileExtension ("json").replaceWithText (json);
+            });
+    }
+};
+}
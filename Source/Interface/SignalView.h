@@ -0,0 +1,145 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include "../DSP/SignalTap.h"
+#include "../DSP/TripleBuffer.h"
+#include "../DSP/BackgroundBuilder.h"
+#include "LookAndFeel.hpp"
+
+namespace oi
+{
+/** The audio actually going through the shaper: an oscilloscope of its input
+    and output, and a scatter of output against input beside it. The paths
+    are built on the shared BackgroundBuilder from the processor's SignalTap,
+    and drawn at a fixed frame rate.
+*/
+class SignalView : public juce::Component,
+                   private juce::Timer,
+                   private op::BackgroundBuilder::Task
+{
+public:
+    SignalView (op::SignalTap& signalTap)
+      : tap (signalTap)
+    {
+        setOpaque (true);
+        pending.resize (static_cast<size_t> (op::SignalTap::capacity));
+        history.reserve (static_cast<size_t> (scatterLength + op::SignalTap::capacity));
+        tap.attach();
+        startTimerHz (frameRate);
+    }
+    ~SignalView() override
+    {
+        stopTimer();
+        builder->cancel (this);
+        tap.detach();
+    }
+    void paint (juce::Graphics& g) override
+    {
+        auto laf = dynamic_cast<OriotoLookAndFeel*> (&getLookAndFeel());
+        jassert (laf != nullptr);
+        g.fillAll (laf->getBaseColour());
+
+        auto b = getLocalBounds().toFloat();
+        auto scatterBounds = b.removeFromRight (b.getHeight()).reduced (2.0f);
+        auto scopeBounds = b.reduced (2.0f, 0.0f);
+
+        g.setColour (laf->getBackgroundColour());
+        g.drawHorizontalLine (juce::roundToInt (scopeBounds.getCentreY()), scopeBounds.getX(), scopeBounds.getRight());
+        g.drawRect (scatterBounds);
+
+        // paths are held in units of the range they show, and scaled here
+        const auto& frame = frames.getReadBuffer();
+        auto scope = juce::AffineTransform::scale (scopeBounds.getWidth(), -scopeBounds.getHeight() / 2.0f)
+                         .translated (scopeBounds.getX(), scopeBounds.getCentreY());
+        auto scatter = juce::AffineTransform::scale (scatterBounds.getWidth() / 2.0f, -scatterBounds.getHeight() / 2.0f)
+                           .translated (scatterBounds.getCentreX(), scatterBounds.getCentreY());
+        g.strokePath (frame.input, juce::PathStrokeType (1.0f), scope);
+
+        g.setColour (laf->getAccentColour());
+        g.strokePath (frame.output, juce::PathStrokeType (1.5f), scope);
+        g.strokePath (frame.scatter, juce::PathStrokeType (1.0f), scatter);
+    }
+private:
+    static constexpr int frameRate = 30;
+    static constexpr int scopeLength = 1024;
+    static constexpr int triggerSearchLength = 512;
+    static constexpr int scatterLength = 4096;
+
+    struct Frame
+    {
+        // scope x runs 0 to 1, everything else -1 to 1
+        juce::Path input, output, scatter;
+    };
+    op::SignalTap& tap;
+    juce::SharedResourcePointer<op::BackgroundBuilder> builder;
+    op::TripleBuffer<Frame> frames;
+
+    // builder thread state: the newest points, oldest first
+    std::vector<juce::Point<float>> pending;
+    std::vector<juce::Point<float>> history;
+
+    void timerCallback() override
+    {
+        if (frames.acquire())
+            repaint();
+        builder->schedule (this);
+    }
+    void run() override
+    {
+        auto numRead = tap.pop (pending.data(), static_cast<int> (pending.size()));
+        if (numRead == 0)
+            return;
+
+        history.insert (history.end(), pending.begin(), pending.begin() + numRead);
+        if (history.size() > static_cast<size_t> (scatterLength))
+            history.erase (history.begin(), history.end() - scatterLength);
+
+        auto& frame = frames.getWriteBuffer();
+        buildScope (frame);
+        frame.scatter.clear();
+        frame.scatter.preallocateSpace (3 * static_cast<int> (history.size()));
+        frame.scatter.startNewSubPath (history.front());
+        for (size_t i = 1; i < history.size(); i++)
+            frame.scatter.lineTo (history[i]);
+        frames.publish();
+    }
+    // The newest scopeLength points, starting at the latest rising zero
+    // crossing of the input that leaves room for them, so periodic signals
+    // stand still
+    void buildScope (Frame& frame)
+    {
+        frame.input.clear();
+        frame.output.clear();
+        auto length = juce::jmin (history.size(), static_cast<size_t> (scopeLength));
+        if (length < 2)
+            return;
+
+        auto start = history.size() - length;
+        auto searchEnd = start > static_cast<size_t> (triggerSearchLength) ? start - triggerSearchLength : 1;
+        for (auto i = start; i >= searchEnd && i > 0; i--)
+        {
+            if (history[i - 1].x < 0.0f && history[i].x >= 0.0f)
+            {
+                start = i;
+                break;
+            }
+        }
+
+        frame.input.preallocateSpace (3 * static_cast<int> (length));
+        frame.output.preallocateSpace (3 * static_cast<int> (length));
+        for (size_t i = 0; i < length; i++)
+        {
+            auto x = static_cast<float> (i) / static_cast<float> (length - 1);
+            const auto& point = history[start + i];
+            if (i == 0)
+            {
+                frame.input.startNewSubPath (x, point.x);
+                frame.output.startNewSubPath (x, point.y);
+                continue;
+            }
+            frame.input.lineTo (x, point.x);
+            frame.output.lineTo (x, point.y);
+        }
+    }
+};
+}
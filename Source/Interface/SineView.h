@@ -1,22 +1,29 @@
 #pragma once
 
 #include <juce_gui_basics/juce_gui_basics.h>
-#include <juce_data_structures/juce_data_structures.h>
-#include "../Identifiers.h"
-#include "../CurvePositionCalculator.h"
+#include "../DSP/TransferFunctionProcessor.h"
 #include "LookAndFeel.hpp"
 
 namespace oi
 {
-class SineView : public juce::Component, 
-                 private juce::ValueTree::Listener
+/** One cycle of a full scale sine, and the same cycle through the curve.
+    The output is read from the table the audio thread plays, and both paths
+    are built only when the size or the compiled curve changes.
+*/
+class SineView : public juce::Component,
+                 private juce::ChangeListener
 {
 public:
-    SineView (juce::ValueTree curveBranch)
-      : state (curveBranch)
+    SineView (op::TransferFunction& tf)
+      : transferFunction (tf),
+        snapshot (tf.getSnapshot())
     {
-        jassert (state.getType() == id::ACTIVE_CURVE);
-        state.addListener (this);
+        setOpaque (true);
+        transferFunction.addChangeListener (this);
+    }
+    ~SineView() override
+    {
+        transferFunction.removeChangeListener (this);
     }
     void paint (juce::Graphics& g) override
     {
@@ -25,82 +32,81 @@ public:
         g.fillAll (laf->getBaseColour());
 
         g.setColour (laf->getBackgroundColour());
-        auto zeroLine = juce::Line<float> ({0.0f, getHeight() / 2.0f}, 
+        auto zeroLine = juce::Line<float> ({0.0f, getHeight() / 2.0f},
                                            {static_cast<float> (getWidth()), getHeight() / 2.0f});
         g.drawLine (zeroLine);
+        g.strokePath (sinePath, juce::PathStrokeType (1.0f));
 
-        juce::Path sineCurve;
-        juce::Point<float> previousPoint = {0.0f, getHeight() / 2.0f};
-        juce::Point<float> nextPoint;
-        sineCurve.startNewSubPath (previousPoint);
-
-        for (int x = 0; x < getWidth(); x += 20)
-        {
-            // paint background sine
-            g.setColour (laf->getBackgroundColour());
-            nextPoint = {static_cast<float> (x), normalToY (std::sin (xToPhase (x)))};
-            juce::Line<float> segment = {previousPoint, nextPoint};
-            sineCurve.addLineSegment (segment, 1.0f);
-            previousPoint = nextPoint;
-        }
-        nextPoint = {static_cast<float> (getWidth()), normalToY (std::sin (xToPhase (getWidth())))};
-        juce::Line<float> finalSegment = {previousPoint, nextPoint};
-        sineCurve.addLineSegment (finalSegment, 1.0f);
-        g.strokePath (sineCurve.createPathWithRoundedCorners (2.0f), juce::PathStrokeType (1.0f));
+        g.setColour (laf->getAccentColour());
+        g.strokePath (outputPath, juce::PathStrokeType (2.0f));
+    }
+    void resized() override
+    {
+        columns.clear();
+        sines.clear();
+        for (int x = 0; x < getWidth(); x += columnWidth)
+            columns.push_back (static_cast<float> (x));
+        columns.push_back (static_cast<float> (getWidth()));
+        for (auto x : columns)
+            sines.push_back (std::sin (xToPhase (x)));
 
-        // paint output
-        CurvePositionCalculator cpc (state);
-        juce::Path outputPath;
-        previousPoint = {0.0f, normalToY (cpc.getYatX (std::sin (xToPhase (0))))};
-        outputPath.startNewSubPath (previousPoint);
-        int skip = 5;
-        for (int x = 0; x < getWidth(); x += skip)
-        {
-            g.setColour (laf->getAccentColour());
-            nextPoint = {static_cast<float> (x), normalToY (cpc.getYatX (std::sin (xToPhase (x))))};
-            outputPath.addLineSegment ({previousPoint, nextPoint}, 1.0f);
-            previousPoint = nextPoint;
-        }
-        nextPoint = {static_cast<float> (getWidth()), 
-                     normalToY (cpc.getYatX (std::sin (xToPhase (getWidth()))))};
-        finalSegment = {previousPoint, nextPoint};
-        outputPath.addLineSegment (finalSegment, 1.0f);
-        g.strokePath (outputPath.createPathWithRoundedCorners (static_cast<float> (skip)), juce::PathStrokeType (2.0f));
+        sinePath = createPath (sines);
+        updateOutputPath();
     }
 private:
-    juce::ValueTree state;
-    juce::Path transferFunction;
+    op::TransferFunction& transferFunction;
+    std::shared_ptr<const op::TransferFunction::Snapshot> snapshot;
+
+    static constexpr int columnWidth = 5;
+    // x of each point on the paths, and the sine there
+    std::vector<float> columns;
+    std::vector<float> sines;
+    juce::Path sinePath;
+    juce::Path outputPath;
 
-    float xToPhase (int x) 
+    float xToPhase (float x)
     {
-        return juce::jmap (static_cast<float> (x), 
-                           0.0f, static_cast<float> (getWidth()), 
+        return juce::jmap (x,
+                           0.0f, static_cast<float> (getWidth()),
                            0.0f, juce::MathConstants<float>::twoPi);
     }
-    float xToNormal (int x)
-    {
-        return juce::jmap (static_cast<float> (x), 
-                           0.0f, static_cast<float> (getWidth()), 
-                           -1.0f, 1.0f);
-    }
     float normalToY (float normal)
     {
         return juce::jmap (normal, -1.0f, 1.0f, static_cast<float> (getHeight()), 0.0f);
     }
-    float indexToNormal (int index)
+    juce::Path createPath (const std::vector<float>& values)
     {
-        return index / static_cast<float> (getWidth());
+        juce::Path path;
+        if (values.empty())
+            return path;
+
+        path.startNewSubPath (columns[0], normalToY (values[0]));
+        for (size_t i = 1; i < values.size(); i++)
+            path.lineTo (columns[i], normalToY (values[i]));
+        return path.createPathWithRoundedCorners (static_cast<float> (columnWidth));
     }
-    void valueTreePropertyChanged (juce::ValueTree& tree,
-                                   const juce::Identifier& property) override
+    void updateOutputPath()
     {
-        juce::ignoreUnused (property);
-        if (tree.getType() == id::endPoint || 
-            tree.getType() == id::controlPoint1 || 
-            tree.getType() == id::controlPoint2)
+        if (snapshot == nullptr)
         {
-            repaint();
+            outputPath.clear();
+            return;
         }
+        std::vector<float> outputs (sines.size());
+        for (size_t i = 0; i < sines.size(); i++)
+            outputs[i] = snapshot->lookUp (sines[i]);
+        outputPath = createPath (outputs);
+    }
+    void changeListenerCallback (juce::ChangeBroadcaster* source) override
+    {
+        juce::ignoreUnused (source);
+        auto latest = transferFunction.getSnapshot();
+        if (latest == snapshot)
+            return;
+
+        snapshot = std::move (latest);
+        updateOutputPath();
+        repaint();
     }
 };
-}
\ No newline at end of file
+}
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include "../DSP/SignalTap.h"
+#include "../DSP/TripleBuffer.h"
+#include "../DSP/BackgroundBuilder.h"
+#include "../DSP/TransferFunctionProcessor.h"
+#include "LookAndFeel.hpp"
+
+namespace oi
+{
+/** Spectra of the plugin's input and output and, beside them, the harmonics
+    the current curve adds to a full scale sine. All FFT work runs on the
+    shared BackgroundBuilder, and the harmonic profile is only recomputed
+    when the compiled curve changes. Resolution and overlap are set from the
+    right click menu.
+*/
+class SpectrumView : public juce::Component,
+                     private juce::Timer,
+                     private juce::ChangeListener,
+                     private op::BackgroundBuilder::Task
+{
+public:
+    static constexpr int numHarmonics = 16;
+
+    SpectrumView (op::SignalTap& analyzerTap, op::TransferFunction& tf)
+      : tap (analyzerTap),
+        transferFunction (tf)
+    {
+        setOpaque (true);
+        pending.resize (static_cast<size_t> (op::SignalTap::capacity));
+        harmonics.fill (floorDecibels);
+        curve = transferFunction.getSnapshot();
+        transferFunction.addChangeListener (this);
+        tap.attach();
+        startTimerHz (frameRate);
+    }
+    ~SpectrumView() override
+    {
+        stopTimer();
+        transferFunction.removeChangeListener (this);
+        builder->cancel (this);
+        tap.detach();
+    }
+    void paint (juce::Graphics& g) override
+    {
+        auto laf = dynamic_cast<OriotoLookAndFeel*> (&getLookAndFeel());
+        jassert (laf != nullptr);
+        g.fillAll (laf->getBaseColour());
+
+        auto b = getLocalBounds().toFloat();
+        auto harmonicBounds = b.removeFromRight (b.getWidth() / 4.0f).reduced (2.0f);
+        auto spectrumBounds = b.reduced (2.0f, 0.0f);
+        const auto& frame = frames.getReadBuffer();
+
+        // a line at each decade
+        g.setColour (laf->getBackgroundColour());
+        for (auto frequency : {100.0f, 1000.0f, 10000.0f})
+        {
+            if (frequency >= frame.maxFrequency)
+                break;
+            auto x = spectrumBounds.getX() + spectrumBounds.getWidth() * frequencyToProportion (frequency, frame.maxFrequency);
+            g.drawVerticalLine (juce::roundToInt (x), spectrumBounds.getY(), spectrumBounds.getBottom());
+        }
+
+        // paths are held in units of the range they show, and scaled here
+        auto spectrum = juce::AffineTransform::scale (spectrumBounds.getWidth(), -spectrumBounds.getHeight())
+                            .translated (spectrumBounds.getX(), spectrumBounds.getBottom());
+        g.strokePath (frame.input, juce::PathStrokeType (1.0f), spectrum);
+        g.setColour (laf->getAccentColour());
+        g.strokePath (frame.output, juce::PathStrokeType (1.5f), spectrum);
+
+        // the fundamental in the background colour, the harmonics added over it
+        auto barWidth = harmonicBounds.getWidth() / numHarmonics;
+        for (size_t k = 0; k < frame.harmonics.size(); k++)
+        {
+            auto bar = harmonicBounds.removeFromLeft (barWidth).reduced (1.0f, 0.0f);
+            g.setColour (k == 0 ? laf->getBackgroundColour() : laf->getAccentColour());
+            g.fillRect (bar.withTrimmedTop (bar.getHeight() * (1.0f - decibelsToProportion (frame.harmonics[k]))));
+        }
+    }
+    void mouseDown (const juce::MouseEvent& event) override
+    {
+        if (event.mods.isPopupMenu())
+            showSettingsMenu();
+    }
+private:
+    static constexpr int frameRate = 30;
+    static constexpr int numPathPoints = 256;
+    static constexpr float minFrequency = 20.0f;
+    static constexpr float floorDecibels = -96.0f;
+    static constexpr float averaging = 0.6f;
+    // the profile's test sine runs this many cycles per transform, so
+    // harmonic k falls exactly on bin k * profileCycles
+    static constexpr int profileOrder = 12;
+    static constexpr int profileCycles = 16;
+
+    struct Frame
+    {
+        Frame() { harmonics.fill (floorDecibels); }
+        // x runs 0 to 1 over log frequency, y 0 to 1 over decibels above the floor
+        juce::Path input, output;
+        float maxFrequency = 22050.0f;
+        std::array<float, numHarmonics> harmonics;
+    };
+    op::SignalTap& tap;
+    op::TransferFunction& transferFunction;
+    juce::SharedResourcePointer<op::BackgroundBuilder> builder;
+    op::TripleBuffer<Frame> frames;
+
+    std::atomic<int> requestedOrder { 12 };
+    std::atomic<int> requestedOverlap { 4 };
+    juce::CriticalSection curveLock;
+    std::shared_ptr<const op::TransferFunction::Snapshot> curve;
+
+    // builder thread state
+    std::vector<juce::Point<float>> pending;
+    int order = 0;
+    int overlap = 0;
+    size_t fftSize = 0;
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    std::vector<juce::Point<float>> samples;
+    size_t numSamples = 0;
+    std::vector<float> fftData;
+    // decibels per bin, averaged over transforms
+    std::vector<float> inputSpectrum;
+    std::vector<float> outputSpectrum;
+    std::array<float, numHarmonics> harmonics;
+    int harmonicsVersion = -1;
+
+    static float frequencyToProportion (float frequency, float maxFrequency)
+    {
+        return std::log (frequency / minFrequency) / std::log (maxFrequency / minFrequency);
+    }
+    static float decibelsToProportion (float decibels)
+    {
+        return juce::jlimit (0.0f, 1.0f, 1.0f - decibels / floorDecibels);
+    }
+
+    void timerCallback() override
+    {
+        if (frames.acquire())
+            repaint();
+        builder->schedule (this);
+    }
+    void changeListenerCallback (juce::ChangeBroadcaster* source) override
+    {
+        juce::ignoreUnused (source);
+        const juce::ScopedLock sl (curveLock);
+        curve = transferFunction.getSnapshot();
+    }
+    void showSettingsMenu()
+    {
+        juce::Component::SafePointer<SpectrumView> safeThis (this);
+        juce::PopupMenu resolution, overlaps;
+        for (int newOrder = 10; newOrder <= 14; newOrder++)
+        {
+            resolution.addItem (juce::String (1 << newOrder) + " points", true, newOrder == requestedOrder.load(),
+                                [safeThis, newOrder]() { if (safeThis != nullptr) safeThis->requestedOrder = newOrder; });
+        }
+        for (int newOverlap : {1, 2, 4, 8})
+        {
+            overlaps.addItem (juce::String (newOverlap) + "x", true, newOverlap == requestedOverlap.load(),
+                              [safeThis, newOverlap]() { if (safeThis != nullptr) safeThis->requestedOverlap = newOverlap; });
+        }
+        juce::PopupMenu menu;
+        menu.addSubMenu ("Resolution", resolution);
+        menu.addSubMenu ("Overlap", overlaps);
+        menu.showMenuAsync (juce::PopupMenu::Options().withTargetComponent (this));
+    }
+
+    void run() override
+    {
+        auto changed = false;
+        if (order != requestedOrder.load() || overlap != requestedOverlap.load())
+        {
+            configure();
+            changed = true;
+        }
+
+        auto numRead = static_cast<size_t> (tap.pop (pending.data(), static_cast<int> (pending.size())));
+        auto hop = fftSize / static_cast<size_t> (overlap);
+        for (size_t i = 0; i < numRead; i++)
+        {
+            samples[numSamples++] = pending[i];
+            if (numSamples < fftSize)
+                continue;
+
+            analyze();
+            std::copy (samples.begin() + static_cast<std::ptrdiff_t> (hop), samples.end(), samples.begin());
+            numSamples -= hop;
+            changed = true;
+        }
+
+        if (updateHarmonics() || changed)
+            publish();
+    }
+    void configure()
+    {
+        order = requestedOrder.load();
+        overlap = requestedOverlap.load();
+        fftSize = static_cast<size_t> (1 << order);
+        fft = std::make_unique<juce::dsp::FFT> (order);
+        window = std::make_unique<juce::dsp::WindowingFunction<float>> (fftSize, juce::dsp::WindowingFunction<float>::hann);
+        samples.assign (fftSize, {});
+        numSamples = 0;
+        fftData.assign (2 * fftSize, 0.0f);
+        inputSpectrum.assign (fftSize / 2 + 1, floorDecibels);
+        outputSpectrum.assign (fftSize / 2 + 1, floorDecibels);
+    }
+    void analyze()
+    {
+        for (auto useOutput : {false, true})
+        {
+            std::fill (fftData.begin(), fftData.end(), 0.0f);
+            for (size_t i = 0; i < fftSize; i++)
+                fftData[i] = useOutput ? samples[i].y : samples[i].x;
+            window->multiplyWithWindowingTable (fftData.data(), fftSize);
+            fft->performFrequencyOnlyForwardTransform (fftData.data());
+
+            // the window is normalised, so a full scale sine reads 0 dB
+            auto& spectrum = useOutput ? outputSpectrum : inputSpectrum;
+            auto scale = 2.0f / static_cast<float> (fftSize);
+            for (size_t bin = 0; bin < spectrum.size(); bin++)
+            {
+                auto decibels = juce::Decibels::gainToDecibels (fftData[bin] * scale, floorDecibels);
+                spectrum[bin] = averaging * spectrum[bin] + (1.0f - averaging) * decibels;
+            }
+        }
+    }
+    // Passes a full scale sine through the compiled curve, if it has changed
+    bool updateHarmonics()
+    {
+        std::shared_ptr<const op::TransferFunction::Snapshot> latest;
+        {
+            const juce::ScopedLock sl (curveLock);
+            latest = curve;
+        }
+        if (latest == nullptr || latest->version == harmonicsVersion)
+            return false;
+        harmonicsVersion = latest->version;
+
+        constexpr size_t size = 1 << profileOrder;
+        std::vector<float> data (2 * size, 0.0f);
+        for (size_t i = 0; i < size; i++)
+        {
+            auto phase = juce::MathConstants<float>::twoPi * profileCycles * static_cast<float> (i) / static_cast<float> (size);
+            data[i] = latest->lookUp (std::sin (phase));
+        }
+        juce::dsp::FFT (profileOrder).performFrequencyOnlyForwardTransform (data.data());
+
+        for (size_t k = 0; k < harmonics.size(); k++)
+        {
+            auto magnitude = data[(k + 1) * profileCycles] * 2.0f / static_cast<float> (size);
+            harmonics[k] = juce::Decibels::gainToDecibels (magnitude, floorDecibels);
+        }
+        return true;
+    }
+    void publish()
+    {
+        auto& frame = frames.getWriteBuffer();
+        frame.maxFrequency = static_cast<float> (tap.getPointRate() / 2.0);
+        frame.harmonics = harmonics;
+        buildPath (frame.input, inputSpectrum, frame.maxFrequency);
+        buildPath (frame.output, outputSpectrum, frame.maxFrequency);
+        frames.publish();
+    }
+    // The loudest bin under each of a fixed number of log spaced points
+    void buildPath (juce::Path& path, const std::vector<float>& spectrum, float maxFrequency) const
+    {
+        path.clear();
+        if (spectrum.empty() || maxFrequency <= minFrequency)
+            return;
+
+        auto binWidth = 2.0f * maxFrequency / static_cast<float> (fftSize);
+        auto lastBin = spectrum.size() - 1;
+        path.preallocateSpace (3 * numPathPoints);
+        for (int point = 0; point < numPathPoints; point++)
+        {
+            auto proportion = static_cast<float> (point) / static_cast<float> (numPathPoints - 1);
+            auto nextProportion = static_cast<float> (point + 1) / static_cast<float> (numPathPoints - 1);
+            auto firstBin = juce::jmin (lastBin, static_cast<size_t> (minFrequency * std::pow (maxFrequency / minFrequency, proportion) / binWidth));
+            auto endBin = juce::jmin (lastBin, static_cast<size_t> (minFrequency * std::pow (maxFrequency / minFrequency, nextProportion) / binWidth));
+
+            auto decibels = *std::max_element (spectrum.begin() + static_cast<std::ptrdiff_t> (firstBin),
+                                               spectrum.begin() + static_cast<std::ptrdiff_t> (juce::jmax (firstBin, endBin) + 1));
+            auto y = decibelsToProportion (decibels);
+            if (point == 0)
+                path.startNewSubPath (proportion, y);
+            else
+                path.lineTo (proportion, y);
+        }
+    }
+};
+}
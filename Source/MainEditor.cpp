@@ -6,14 +6,25 @@ MainEditor::MainEditor (MainProcessor& p)
     : AudioProcessorEditor (&p), processorRef (p), 
       undoManager (processorRef.getUndoManager()),
       curveEditor (processorRef.getState().getChildWithName (id::CURVE), processorRef.getUndoManager()),
-      sineView (processorRef.getState().getChildWithName (id::CURVE).getChildWithName (id::ACTIVE_CURVE)), 
-      controlPanel (processorRef.getValueTreeState())
+      sineView (processorRef.getTransferFunction()), 
+      signalView (processorRef.getSignalTap()),
+      spectrumView (processorRef.getAnalyzerTap(), processorRef.getTransferFunction()),
+      controlPanel (processorRef.getValueTreeState(), processorRef.getMeters())
+     #if ORIOTO_PROFILING
+      , profilerOverlay (processorRef.getProfiler())
+     #endif
 {
     setLookAndFeel (&lookAndFeel);
     
     addAndMakeVisible (curveEditor);
     addAndMakeVisible (sineView);
+    addAndMakeVisible (signalView);
+    addAndMakeVisible (spectrumView);
     addAndMakeVisible (controlPanel);
+   #if ORIOTO_PROFILING
+    // shown and hidden with cmd-shift-P
+    addChildComponent (profilerOverlay);
+   #endif
 
     setWantsKeyboardFocus (true);
     addKeyListener (this);
@@ -40,10 +51,17 @@ void MainEditor::resized()
     auto thirdWidth = b.getWidth() / 3;
     auto controlBounds = b.removeFromLeft (thirdWidth);
     auto viewBounds = b.removeFromLeft (thirdWidth * 2);
-    sineView.setBounds (viewBounds.removeFromBottom (viewBounds.getHeight() / 5).reduced (2));
+    auto previewBounds = viewBounds.removeFromBottom (viewBounds.getHeight() / 5);
+    auto previewWidth = previewBounds.getWidth() / 3;
+    sineView.setBounds (previewBounds.removeFromLeft (previewWidth).reduced (2));
+    signalView.setBounds (previewBounds.removeFromLeft (previewWidth).reduced (2));
+    spectrumView.setBounds (previewBounds.reduced (2));
     curveEditor.setBounds (viewBounds.reduced (2));
 
     controlPanel.setBounds (controlBounds);
+   #if ORIOTO_PROFILING
+    profilerOverlay.setBounds (getLocalBounds().removeFromRight (320).removeFromTop (profilerOverlay.getIdealHeight()));
+   #endif
 }
 
 bool MainEditor::keyPressed (const juce::KeyPress& key,
@@ -58,5 +76,12 @@ bool MainEditor::keyPressed (const juce::KeyPress& key,
     {
         undoManager.redo();
     }
+   #if ORIOTO_PROFILING
+    else if (key.getModifiers().isCommandDown() && key.getModifiers().isShiftDown() && (key.getKeyCode() == 'p' || key.getKeyCode() == 'P'))
+    {
+        profilerOverlay.setVisible (! profilerOverlay.isVisible());
+        return true;
+    }
+   #endif
     return false;
 }
\ No newline at end of file
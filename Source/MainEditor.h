@@ -4,7 +4,12 @@
 #include "Interface/LookAndFeel.hpp"
 #include "Interface/CurveEditor.h"
 #include "Interface/SineView.h"
+#include "Interface/SignalView.h"
+#include "Interface/SpectrumView.h"
 #include "Interface/ControlPanel.h"
+#if ORIOTO_PROFILING
+ #include "Interface/ProfilerOverlay.h"
+#endif
 
 //==============================================================================
 class MainEditor final : public juce::AudioProcessorEditor,
@@ -25,7 +30,12 @@ private:
 
     oi::CurveEditor curveEditor;
     oi::SineView sineView;
+    oi::SignalView signalView;
+    oi::SpectrumView spectrumView;
     oi::ControlPanel controlPanel;
+   #if ORIOTO_PROFILING
+    oi::ProfilerOverlay profilerOverlay;
+   #endif
 
     bool keyPressed (const juce::KeyPress& key,
                      juce::Component* originatingComponent) override;
@@ -1,8 +1,12 @@
 #include "MainProcessor.h"
-#include "MainEditor.h"
+#if ! ORIOTO_HEADLESS
+ #include "MainEditor.h"
+#endif
 #include "Identifiers.h"
 #include "DefaultTreeGenerator.h"
 #include "Parameters.h"
+#include "RealtimeChecks.h"
+#include "StateFile.h"
 
 //==============================================================================
 MainProcessor::MainProcessor()
@@ -14,11 +18,25 @@ MainProcessor::MainProcessor()
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
                        ), 
-      valueTreeState (*this, &undoManager, id::ORIOTO, createParameterLayout()), 
-      overSampler (2, 3, juce::dsp::Oversampling<float>::FilterType::filterHalfBandPolyphaseIIR)
+      valueTreeState (*this, &undoManager, id::ORIOTO, createParameterLayout()),
+      undoManager (maxUndoBytes, minUndoSteps)
 {
     valueTreeState.state.addChild (CurveBranch::create(), -1, nullptr);
-    transferFunctionProcessor = std::make_unique<op::TransferFunctionProcessor<float>> (getState().getChildWithName (id::CURVE).getChildWithName (id::ACTIVE_CURVE));
+    transferFunctionProcessor = std::make_unique<op::TransferFunctionProcessor<float>> (getState().getChildWithName (id::CURVE));
+
+    for (size_t i = 0; i < nodeParameters.size(); i++)
+    {
+        auto slot = "Node" + juce::String (i + 1);
+        nodeParameters[i] = {valueTreeState.getRawParameterValue (slot + "X"), 
+                             valueTreeState.getRawParameterValue (slot + "Y")};
+    }
+
+    inputChain.get<1>().setMeter (meters.input);
+    inputChain.get<3>().setMeter (meters.inputCompressorIn);
+    inputChain.get<5>().setMeter (meters.inputCompressorOut, &meters.inputCompressorIn);
+    outputChain.get<3>().setMeter (meters.outputCompressorIn);
+    outputChain.get<5>().setMeter (meters.outputCompressorOut, &meters.outputCompressorIn);
+    outputChain.get<7>().setMeter (meters.output);
 }
 
 MainProcessor::~MainProcessor()
@@ -102,26 +120,50 @@ void MainProcessor::prepareToPlay (double sr, int samplesPerBlock)
     spec.sampleRate = sr;
     sampleRate = sr;
     
+    // hosts make many instances while loading a session, and only play some
+    if (overSampler == nullptr)
+        overSampler = std::make_unique<juce::dsp::Oversampling<float>> (2, 3, juce::dsp::Oversampling<float>::FilterType::filterHalfBandPolyphaseIIR);
+
     transferFunctionProcessor->prepare (spec);
+    transferFunctionProcessor->getSignalTap().prepare (sr * static_cast<double> (overSampler->getOversamplingFactor()));
+    analyzerTap.prepare (sr, sr);
+    analyzerInput.setSize (1, samplesPerBlock);
+   #if ORIOTO_PROFILING
+    profiler.prepare (sr);
+   #endif
     auto& inputGain = inputChain.get<0>();
     inputGain.setRampDurationSeconds (0.01);
 
-    auto& lowShelf = inputChain.get<1>();
+    auto& lowShelf = inputChain.get<2>();
     *lowShelf.state = juce::dsp::IIR::ArrayCoefficients<float>::makeLowShelf (spec.sampleRate, 400.0f, 1.0f, juce::Decibels::decibelsToGain (0.0f));
 
     inputChain.prepare (spec);
 
-    overSampler.reset();
-    overSampler.initProcessing (static_cast<unsigned long> (samplesPerBlock));
+    overSampler->initProcessing (static_cast<unsigned long> (samplesPerBlock));
+    // the oversampling filters are the only delay in the chain; hosts
+    // compensate whole samples, so the fraction is rounded up
+    setLatencySamples (static_cast<int> (std::ceil (overSampler->getLatencyInSamples())));
 
     auto& dcFilter = outputChain.get<0>();
     *dcFilter.state = juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass (sampleRate, 5.0f);
 
-    auto& outputLevel = outputChain.get<4>();
+    auto& outputLevel = outputChain.get<6>();
     outputLevel.setRampDurationSeconds (0.01);
     
     outputChain.prepare (spec);
     phaseIncrement = juce::MathConstants<double>::twoPi * 440.0 / sampleRate;
+    reset();
+}
+
+void MainProcessor::reset()
+{
+    // hosts call this from the audio thread when the transport jumps, so
+    // only the filter and ramp state is cleared; nothing is resized
+    ORIOTO_REALTIME_SECTION;
+    inputChain.reset();
+    if (overSampler != nullptr)
+        overSampler->reset();
+    outputChain.reset();
 }
 
 void MainProcessor::releaseResources()
@@ -159,7 +201,9 @@ void MainProcessor::processBlock (juce::AudioBuffer<float>& buffer,
 {
     juce::ignoreUnused (midiMessages);
 
+    ORIOTO_REALTIME_SECTION;
     juce::ScopedNoDenormals noDenormals;
+    ORIOTO_PROFILE_BEGIN_BLOCK (profiler);
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -173,6 +217,18 @@ void MainProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     //     phase = std::fmod (phase + phaseIncrement, juce::MathConstants<double>::twoPi);
     // }
     // buffer.copyFrom (1, 0, buffer.getReadPointer (0), buffer.getNumSamples());
+    const bool analyzing = analyzerTap.isActive();
+    const auto numAnalyzed = juce::jmin (buffer.getNumSamples(), analyzerInput.getNumSamples());
+    if (analyzing)
+    {
+        analyzerInput.copyFrom (0, 0, buffer, 0, 0, numAnalyzed);
+        if (buffer.getNumChannels() > 1)
+        {
+            analyzerInput.addFrom (0, 0, buffer, 1, 0, numAnalyzed);
+            analyzerInput.applyGain (0.5f);
+        }
+    }
+
     auto& inputGain = inputChain.get<0>();
     inputGain.setGainDecibels (*valueTreeState.getRawParameterValue ("InputGain"));
     
@@ -182,14 +238,14 @@ void MainProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     if (!juce::approximatelyEqual (sampleRate, 0.0))
     {
         auto settings = smoothFilterSettings.getSettings(); juce::ignoreUnused (settings);
-        auto& lowShelf = inputChain.get<1>(); juce::ignoreUnused (lowShelf);
+        auto& lowShelf = inputChain.get<2>(); juce::ignoreUnused (lowShelf);
         *lowShelf.state = juce::dsp::IIR::ArrayCoefficients<float>::makeLowShelf 
             (sampleRate, 
             settings.frequency, 
             settings.q, 
             juce::Decibels::decibelsToGain (settings.gain));
     }
-    auto& inputCompressor = inputChain.get<2>();
+    auto& inputCompressor = inputChain.get<4>();
     inputCompressor.setAttack (*valueTreeState.getRawParameterValue ("InputCompressionAttack"));
     inputCompressor.setRelease (*valueTreeState.getRawParameterValue ("InputCompressionRelease"));
     inputCompressor.setRatio (*valueTreeState.getRawParameterValue ("InputCompressionRatio"));
@@ -197,13 +253,26 @@ void MainProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     
     auto inputBlock = juce::dsp::AudioBlock<float> (buffer);
     auto inputContext = juce::dsp::ProcessContextReplacing (inputBlock);
+    ORIOTO_PROFILE_START (profiler);
     inputChain.process (inputContext);
+    ORIOTO_PROFILE_STOP (profiler, inputChain);
 
-    auto upSampledBlock = overSampler.processSamplesUp (inputBlock);
+    ORIOTO_PROFILE_START (profiler);
+    auto upSampledBlock = overSampler->processSamplesUp (inputBlock);
+    ORIOTO_PROFILE_STOP (profiler, upsampling);
     auto upSampledContext = juce::dsp::ProcessContextReplacing<float> (upSampledBlock);
     transferFunctionProcessor->setMix (*valueTreeState.getRawParameterValue ("Blend"));
+    transferFunctionProcessor->setScan (valueTreeState.getRawParameterValue ("CurveScan")->load() > 0.5f, 
+                                        *valueTreeState.getRawParameterValue ("ScanPosition"));
+    for (size_t i = 0; i < nodeParameters.size(); i++)
+        transferFunctionProcessor->setNodeOffset (static_cast<int> (i), {nodeParameters[i].x->load(), 
+                                                                         nodeParameters[i].y->load()});
+    ORIOTO_PROFILE_START (profiler);
     transferFunctionProcessor->process (upSampledContext);
-    overSampler.processSamplesDown (inputBlock);
+    ORIOTO_PROFILE_STOP (profiler, shaping);
+    ORIOTO_PROFILE_START (profiler);
+    overSampler->processSamplesDown (inputBlock);
+    ORIOTO_PROFILE_STOP (profiler, downsampling);
 
     auto& highShelf = outputChain.get<1>(); juce::ignoreUnused (highShelf);
         *highShelf.state = juce::dsp::IIR::ArrayCoefficients<float>::makeHighShelf 
@@ -216,51 +285,94 @@ void MainProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     *lowPass.state = juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass 
         (sampleRate, *valueTreeState.getRawParameterValue ("LowPassFrequency"));
  
-    auto& outputCompressor = outputChain.get<3>();
+    auto& outputCompressor = outputChain.get<4>();
     outputCompressor.setAttack (*valueTreeState.getRawParameterValue ("OutputCompressionAttack"));
     outputCompressor.setRelease (*valueTreeState.getRawParameterValue ("OutputCompressionRelease"));
     outputCompressor.setRatio (*valueTreeState.getRawParameterValue ("OutputCompressionRatio"));
     outputCompressor.setThreshold (*valueTreeState.getRawParameterValue ("OutputCompressionThreshold"));
 
-    auto& outputLevel = outputChain.get<4>();
+    auto& outputLevel = outputChain.get<6>();
     outputLevel.setGainDecibels (*valueTreeState.getRawParameterValue ("OutputLevel"));
 
     auto outputBlock = juce::dsp::AudioBlock<float> (buffer);
     auto outputContext = juce::dsp::ProcessContextReplacing<float> (outputBlock);
 
+    ORIOTO_PROFILE_START (profiler);
     outputChain.process (outputContext);
+    ORIOTO_PROFILE_STOP (profiler, outputChain);
+
+    if (analyzing)
+    {
+        const auto* input = analyzerInput.getReadPointer (0);
+        const auto* left = buffer.getReadPointer (0);
+        const auto* right = buffer.getReadPointer (buffer.getNumChannels() > 1 ? 1 : 0);
+        for (int i = 0; i < numAnalyzed; i++)
+            analyzerTap.push (input[i], 0.5f * (left[i] + right[i]));
+    }
+    ORIOTO_PROFILE_END_BLOCK (profiler, buffer.getNumSamples());
 }
 
 //==============================================================================
 bool MainProcessor::hasEditor() const
 {
+   #if ORIOTO_HEADLESS
+    return false;
+   #else
     return true; // (change this to false if you choose to not supply an editor)
+   #endif
 }
 
 juce::AudioProcessorEditor* MainProcessor::createEditor()
 {
+   #if ORIOTO_HEADLESS
+    return nullptr;
+   #else
     return new MainEditor (*this);
+   #endif
 }
 
 //==============================================================================
 void MainProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
     auto state = valueTreeState.copyState();
+    if (StateFile::write (state, destData))
+        return;
     std::unique_ptr<juce::XmlElement> xml (state.createXml());
     copyXmlToBinary (*xml, destData);
 }
 
 void MainProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // juce::ignoreUnused (data, sizeInBytes);
-    std::unique_ptr<juce::XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
-
-    // if (xmlState.get() != nullptr)
-    //     if (xmlState->hasTagName (valueTreeState.state.getType()))
-    //         valueTreeState.replaceState (juce::ValueTree::fromXml (*xmlState));
-    // if (xmlState.get() != nullptr)
-    //     if (xmlState->hasTagName (valueTreeState.state.getType()))
-    //         syncValueTreeNotifyListeners (juce::ValueTree::fromXml (*xmlState), valueTreeState.state);
+    auto state = StateFile::read (data, sizeInBytes);
+    if (! state.hasType (valueTreeState.state.getType()))
+        return;
+
+    // replaceState() would swap the tree out from under the transfer
+    // function and the editor, so only the differences are written. Their
+    // listeners gather the changes, and the curve is compiled once here.
+    syncValueTreeNotifyListeners (state, valueTreeState.state);
+    transferFunctionProcessor->getTransferFunction().updateNowIfNeeded();
+    undoManager.clearUndoHistory();
+}
+
+void MainProcessor::resetToDefault (juce::ValueTree& branch)
+{
+    // parameters go back to their default value, as replaceState() would
+    static const juce::Identifier parameterId ("id"), parameterValue ("value");
+    if (auto* parameter = valueTreeState.getParameter (branch.getProperty (parameterId).toString()))
+    {
+        branch.setProperty (parameterValue, parameter->convertFrom0to1 (parameter->getDefaultValue()), nullptr);
+        return;
+    }
+    // other branches are matched to a new state's by their path of types
+    juce::Array<juce::Identifier> path;
+    for (auto parent = branch; parent.getParent().isValid(); parent = parent.getParent())
+        path.insert (0, parent.getType());
+    auto defaultBranch = DefaultTree::create();
+    for (const auto& type : path)
+        defaultBranch = defaultBranch.getChildWithName (type);
+    if (defaultBranch.isValid())
+        syncValueTreeNotifyListeners (defaultBranch, branch);
 }
 
 //==============================================================================
@@ -297,6 +409,17 @@ juce::AudioProcessorValueTreeState::ParameterLayout MainProcessor::createParamet
 
     layout.add (std::make_unique<op::NormalizedFloatParameter> ("Blend", 1.0f));
 
+    layout.add (std::make_unique<op::ChoiceParameter> ("Curve Scan", juce::StringArray {"Off", "On"}, ""));
+    layout.add (std::make_unique<op::NormalizedFloatParameter> ("Scan Position", 0.0f));
+
+    // Offsets applied to the active curve's nodes, by node index
+    range = {-1.0f, 1.0f};
+    for (int i = 1; i <= op::TransferFunction::numAutomatedNodes; i++)
+    {
+        layout.add (std::make_unique<op::RangedFloatParameter> ("Node " + juce::String (i) + " X", range, 0.0f));
+        layout.add (std::make_unique<op::RangedFloatParameter> ("Node " + juce::String (i) + " Y", range, 0.0f));
+    }
+
     range = {1000.0f, 10000.0f}; range.setSkewForCentre (4000.0f);
     layout.add (std::make_unique<op::RangedFloatParameter> ("High Shelf Frequency", range, 4000.0f));
     range = {-8.0f, 8.0f};
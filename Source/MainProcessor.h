@@ -3,6 +3,13 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_dsp/juce_dsp.h>
 #include "DSP/TransferFunctionProcessor.h"
+#include "DSP/Metering.h"
+#include "DSP/StageProfiler.h"
+
+// Set for builds without the editor, such as OriotoRender
+#ifndef ORIOTO_HEADLESS
+ #define ORIOTO_HEADLESS 0
+#endif
 //==============================================================================
 class MainProcessor final : public juce::AudioProcessor
 {
@@ -14,6 +21,7 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void reset() override;
 
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 
@@ -46,17 +54,39 @@ public:
     juce::AudioProcessorValueTreeState& getValueTreeState() { return valueTreeState; }
     juce::ValueTree& getState() { return valueTreeState.state; }
     juce::UndoManager& getUndoManager() { return undoManager; }
+    op::TransferFunction& getTransferFunction() { return transferFunctionProcessor->getTransferFunction(); }
+    op::SignalTap& getSignalTap() { return transferFunctionProcessor->getSignalTap(); }
+    op::Meters& getMeters() { return meters; }
+    // Mono sums of the plugin's input and output, at the host rate
+    op::SignalTap& getAnalyzerTap() { return analyzerTap; }
+   #if ORIOTO_PROFILING
+    op::StageProfiler& getProfiler() { return profiler; }
+   #endif
 private:
     juce::AudioProcessorValueTreeState valueTreeState;
+    // curve edits are sized by the nodes they hold, so this bounds the
+    // history's memory once more than the minimum number of steps are kept
+    static constexpr int maxUndoBytes = 1 << 20;
+    static constexpr int minUndoSteps = 30;
     juce::UndoManager undoManager;
     double sampleRate;
     std::unique_ptr<op::TransferFunctionProcessor<float>> transferFunctionProcessor;
-    juce::dsp::Oversampling<float> overSampler;
+    // made by the first prepareToPlay
+    std::unique_ptr<juce::dsp::Oversampling<float>> overSampler;
+    op::Meters meters;
+    op::SignalTap analyzerTap;
+    juce::AudioBuffer<float> analyzerInput;
+   #if ORIOTO_PROFILING
+    op::StageProfiler profiler;
+   #endif
 
     juce::dsp::ProcessorChain<juce::dsp::Gain<float>,
+                              op::MeterStage,
                               juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, 
                                                              juce::dsp::IIR::Coefficients<float>>,
-                              juce::dsp::Compressor<float>> inputChain;
+                              op::MeterStage,
+                              juce::dsp::Compressor<float>,
+                              op::MeterStage> inputChain;
     
     juce::dsp::ProcessorChain<juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>,
                                                              juce::dsp::IIR::Coefficients<float>>,
@@ -64,8 +94,11 @@ private:
                                                              juce::dsp::IIR::Coefficients<float>>,
                               juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, 
                                                              juce::dsp::IIR::Coefficients<float>>,
+                              op::MeterStage,
                               juce::dsp::Compressor<float>,
-                              juce::dsp::Gain<float>> outputChain;
+                              op::MeterStage,
+                              juce::dsp::Gain<float>,
+                              op::MeterStage> outputChain;
     
     struct FilterSettings
     {
@@ -98,31 +131,75 @@ private:
         juce::SmoothedValue<float> q;
     };
     SmoothFilterSettings smoothFilterSettings;
+
+    struct NodeParameters
+    {
+        std::atomic<float>* x = nullptr;
+        std::atomic<float>* y = nullptr;
+    };
+    std::array<NodeParameters, op::TransferFunction::numAutomatedNodes> nodeParameters;
     double phase = 0;
     double phaseIncrement = 0.001;
 
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    // Brings destination in line with source through the ordinary setters,
+    // so listeners hear only about what actually differs. Children are
+    // matched in order while their types (and parameter ids) agree, and
+    // searched for otherwise, so branches that exist in both are kept.
+    // Children the source lacks are only removed from lists (nodes and
+    // presets); anything else, such as a parameter or branch added since
+    // the state was saved, stays attached and is reset to its default.
     void syncValueTreeNotifyListeners (const juce::ValueTree& source, juce::ValueTree& destination)
     {
+        for (int i = destination.getNumProperties(); --i >= 0;)
+        {
+            auto propertyName = destination.getPropertyName (i);
+            if (! source.hasProperty (propertyName))
+                destination.removeProperty (propertyName, nullptr);
+        }
         const int numProperties = source.getNumProperties();
         for (int i = 0; i < numProperties; ++i)
         {
             auto propertyName = source.getPropertyName (i);
-    
-            if (destination.hasProperty (propertyName))
-                destination.setProperty (propertyName, source.getProperty (propertyName), nullptr);
+            destination.setProperty (propertyName, source.getProperty (propertyName), nullptr);
         }
     
-        // for (const auto& child : source)
+        static const juce::Identifier parameterId ("id");
+        auto matches = [](const juce::ValueTree& a, const juce::ValueTree& b)
+            {
+                return a.hasType (b.getType()) && a.getProperty (parameterId) == b.getProperty (parameterId);
+            };
         for (int i = 0; i < source.getNumChildren(); i++)
         {
             auto child = source.getChild (i);
-            // auto childType = source.getChild (i).getType();
             auto childInDestination = destination.getChild (i);
-    
+            if (! matches (child, childInDestination))
+            {
+                childInDestination = {};
+                for (int j = i + 1; j < destination.getNumChildren(); j++)
+                {
+                    if (matches (child, destination.getChild (j)))
+                    {
+                        destination.moveChild (j, i, nullptr);
+                        childInDestination = destination.getChild (i);
+                        break;
+                    }
+                }
+            }
             if (childInDestination.isValid())
                 syncValueTreeNotifyListeners (child, childInDestination);
-        }       
+            else
+                destination.addChild (child.createCopy(), i, nullptr);
+        }
+        for (int i = destination.getNumChildren(); --i >= source.getNumChildren();)
+        {
+            auto child = destination.getChild (i);
+            if (child.hasType (id::NODE) || destination.hasType (id::PRESETS))
+                destination.removeChild (i, nullptr);
+            else
+                resetToDefault (child);
+        }
     }
+    void resetToDefault (juce::ValueTree& branch);
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainProcessor)
 };
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <juce_data_structures/juce_data_structures.h>
+#include "Identifiers.h"
+#include "DefaultTreeGenerator.h"
+
+/** The user's curve library, kept on disk instead of in each session and
+    shared by every instance in the process. The file is memory-mapped and
+    only its fixed-size header is read on opening, so that costs the same
+    for ten curves as for ten thousand. Names are read from the index as
+    they're listed, and a curve's nodes are decoded when it is selected.
+    Little-endian:
+
+        "ORLB", int32 version, int32 numEntries, then per entry int64 hash
+        of its nodes and int32 offset and size of its name, its tags and
+        its nodes. After the index come the UTF-8 names, the comma separated
+        tags, and the nodes packed as in CurveFile: uint8 segment type,
+        float32 x, y, and the control points relative to it x1, y1, x2, y2
+
+    Additions rewrite the file beside the old one and swap it in, holding
+    an inter-process lock from reading the entries to the swap. Other
+    instances pick them up the next time they refresh().
+*/
+class PresetLibrary : public juce::ChangeBroadcaster
+{
+public:
+    PresetLibrary()
+      : PresetLibrary (juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory)
+                           .getChildFile ("Orioto").getChildFile ("Library.oriotolibrary"))
+    {}
+    explicit PresetLibrary (const juce::File& fileToUse)
+      : file (fileToUse),
+        fileLock ("OriotoLibrary" + juce::String::toHexString (fileToUse.getFullPathName().hashCode64()))
+    {
+        open();
+    }
+
+    int getNumEntries() const { return numEntries; }
+    // Goes up each time the entries change, for lists built from them
+    int getVersion() const { return version; }
+
+    juce::int64 getHash (int index) const
+    {
+        jassert (juce::isPositiveAndBelow (index, numEntries));
+        return static_cast<juce::int64> (juce::ByteOrder::littleEndianInt64 (data + getEntryOffset (index)));
+    }
+    juce::String getName (int index) const
+    {
+        auto span = getSpan (index, nameField);
+        return juce::String::fromUTF8 (data + span.offset, static_cast<int> (span.size));
+    }
+    juce::StringArray getTags (int index) const
+    {
+        auto span = getSpan (index, tagsField);
+        auto text = juce::String::fromUTF8 (data + span.offset, static_cast<int> (span.size));
+        return juce::StringArray::fromTokens (text, ",", {});
+    }
+    int indexOf (juce::int64 hash) const
+    {
+        for (int i = 0; i < numEntries; i++)
+            if (getHash (i) == hash)
+                return i;
+        return -1;
+    }
+    // Decodes an entry into a new CURVE branch, or an invalid tree if its
+    // data is damaged
+    juce::ValueTree loadCurve (int index) const
+    {
+        auto span = getSpan (index, nodesField);
+        auto numNodes = span.size / bytesPerNode;
+        if (numNodes < 2 || span.size % bytesPerNode != 0)
+            return {};
+
+        juce::ValueTree curveBranch (id::CURVE);
+        curveBranch.setProperty (id::name, getName (index), nullptr);
+        auto previousX = -1.0f;
+        for (size_t i = 0; i < numNodes; i++)
+        {
+            auto* packed = data + span.offset + i * bytesPerNode;
+            auto type = static_cast<int> (static_cast<juce::uint8> (packed[0]));
+            std::array<float, 6> values {};
+            for (size_t v = 0; v < values.size(); v++)
+                values[v] = readFloat (packed + 1 + 4 * v);
+
+            if (type >= segmentTypeNames.size()
+                || ! std::all_of (values.begin(), values.end(), [](float value) { return std::isfinite (value); })
+                || values[0] < previousX || values[0] > 1.0f)
+                return {};
+            previousX = values[0];
+
+            auto nodeBranch = NodeBranch::create ({values[0], values[1]}, {values[2], values[3]}, {values[4], values[5]});
+            if (type != static_cast<int> (SegmentType::bezier))
+                nodeBranch.setProperty (id::segmentType, type, nullptr);
+            curveBranch.addChild (nodeBranch, -1, nullptr);
+        }
+        return curveBranch;
+    }
+
+    struct Entry
+    {
+        juce::ValueTree curveBranch;
+        juce::String name;
+        juce::StringArray tags;
+    };
+    // Adds a curve's nodes under the given name, unless the library already
+    // holds the same nodes. Returns the entry's index, or -1 on failure.
+    int add (const juce::ValueTree& curveBranch, const juce::String& name, const juce::StringArray& tags)
+    {
+        auto indices = addAll ({{curveBranch, name, tags}});
+        return indices.isEmpty() ? -1 : indices.getFirst();
+    }
+    // Adds several curves with a single rewrite of the file, as add() does
+    // one. Returns each one's entry index, or nothing on failure.
+    juce::Array<int> addAll (const std::vector<Entry>& entries)
+    {
+        // another process adding at the same time would otherwise drop
+        // whichever entries were written first
+        const juce::InterProcessLock::ScopedLockType lock (fileLock);
+        if (! lock.isLocked())
+            return {};
+        refresh();
+
+        // the existing entries' fields are copied over as they are
+        std::vector<Record> records;
+        juce::MemoryOutputStream text, packed;
+        auto append = [](juce::MemoryOutputStream& stream, const void* source, size_t size)
+            {
+                Span span { stream.getDataSize(), size };
+                stream.write (source, size);
+                return span;
+            };
+        for (int i = 0; i < numEntries; i++)
+        {
+            auto nameSpan = getSpan (i, nameField), tagSpan = getSpan (i, tagsField), nodeSpan = getSpan (i, nodesField);
+            records.push_back ({getHash (i), {append (text, data + nameSpan.offset, nameSpan.size),
+                                              append (text, data + tagSpan.offset, tagSpan.size),
+                                              append (packed, data + nodeSpan.offset, nodeSpan.size)}});
+        }
+
+        juce::Array<int> indices;
+        for (const auto& entry : entries)
+        {
+            auto nodes = CurvePositionCalculator::readNodes (entry.curveBranch);
+            if (nodes.size() < 2)
+                return {};
+            juce::MemoryOutputStream nodeData;
+            pack (nodes, nodeData);
+
+            // the packed nodes are compared too, so a collision adds an
+            // entry instead of finding the wrong one
+            Record added { CurvePositionCalculator::hashNodes (nodes), {} };
+            auto existing = std::find_if (records.begin(), records.end(), [&](const Record& record)
+                {
+                    auto span = record.spans[nodesField];
+                    return record.hash == added.hash && span.size == nodeData.getDataSize()
+                        && std::memcmp (static_cast<const char*> (packed.getData()) + span.offset, nodeData.getData(), span.size) == 0;
+                });
+            if (existing != records.end())
+            {
+                indices.add (static_cast<int> (existing - records.begin()));
+                continue;
+            }
+            added.spans[nameField] = append (text, entry.name.toRawUTF8(), entry.name.getNumBytesAsUTF8());
+            auto joinedTags = entry.tags.joinIntoString (",");
+            added.spans[tagsField] = append (text, joinedTags.toRawUTF8(), joinedTags.getNumBytesAsUTF8());
+            added.spans[nodesField] = append (packed, nodeData.getData(), nodeData.getDataSize());
+            indices.add (static_cast<int> (records.size()));
+            records.push_back (added);
+        }
+
+        if (records.size() == static_cast<size_t> (numEntries))
+            return indices;
+        if (! write (records, text, packed))
+            return {};
+        sendChangeMessage();
+        return indices;
+    }
+    // Reopens the file if it has changed on disk, and returns true if so
+    bool refresh()
+    {
+        if (file.getLastModificationTime() == modificationTime)
+            return false;
+        open();
+        sendChangeMessage();
+        return true;
+    }
+private:
+    static constexpr int magic = ('O' << 0) | ('R' << 8) | ('L' << 16) | ('B' << 24);
+    static constexpr int fileVersion = 1;
+    static constexpr size_t headerSize = 12;
+    static constexpr size_t numFields = 3;
+    static constexpr size_t entrySize = 8 + numFields * 8;
+    static constexpr size_t bytesPerNode = 1 + 6 * 4;
+    enum Field : size_t { nameField, tagsField, nodesField };
+
+    struct Span
+    {
+        size_t offset = 0;
+        size_t size = 0;
+    };
+    struct Record
+    {
+        juce::int64 hash;
+        std::array<Span, numFields> spans;
+    };
+
+    juce::File file;
+    juce::InterProcessLock fileLock;
+    juce::Time modificationTime;
+    std::unique_ptr<juce::MemoryMappedFile> map;
+    const char* data = nullptr;
+    size_t dataSize = 0;
+    int numEntries = 0;
+    int version = 0;
+
+    void open()
+    {
+        map.reset();
+        data = nullptr;
+        dataSize = 0;
+        numEntries = 0;
+        version++;
+        modificationTime = file.getLastModificationTime();
+        if (! file.existsAsFile())
+            return;
+
+        map = std::make_unique<juce::MemoryMappedFile> (file, juce::MemoryMappedFile::readOnly);
+        data = static_cast<const char*> (map->getData());
+        dataSize = map->getSize();
+        if (data == nullptr || dataSize < headerSize || readInt (data) != magic || readInt (data + 4) > fileVersion)
+            return close();
+
+        auto count = readInt (data + 8);
+        if (count < 0 || headerSize + static_cast<size_t> (count) * entrySize > dataSize)
+            return close();
+        numEntries = count;
+    }
+    static void pack (const juce::Array<Node>& nodes, juce::MemoryOutputStream& stream)
+    {
+        for (const auto& node : nodes)
+        {
+            stream.writeByte (static_cast<char> (node.type));
+            for (auto value : {node.endPoint.x, node.endPoint.y,
+                               node.controlPointOne.x - node.endPoint.x, node.controlPointOne.y - node.endPoint.y,
+                               node.controlPointTwo.x - node.endPoint.x, node.controlPointTwo.y - node.endPoint.y})
+                stream.writeFloat (value);
+        }
+    }
+    void close()
+    {
+        map.reset();
+        data = nullptr;
+        dataSize = 0;
+        numEntries = 0;
+    }
+    bool write (const std::vector<Record>& records, const juce::MemoryOutputStream& text, const juce::MemoryOutputStream& packed)
+    {
+        if (! file.getParentDirectory().createDirectory())
+            return false;
+
+        auto textStart = headerSize + records.size() * entrySize;
+        auto packedStart = textStart + text.getDataSize();
+        juce::TemporaryFile temporary (file);
+        {
+            juce::FileOutputStream stream (temporary.getFile());
+            if (! stream.openedOk())
+                return false;
+            stream.writeInt (magic);
+            stream.writeInt (fileVersion);
+            stream.writeInt (static_cast<int> (records.size()));
+            for (const auto& record : records)
+            {
+                stream.writeInt64 (record.hash);
+                for (size_t field = 0; field < numFields; field++)
+                {
+                    auto start = field == nodesField ? packedStart : textStart;
+                    stream.writeInt (static_cast<int> (start + record.spans[field].offset));
+                    stream.writeInt (static_cast<int> (record.spans[field].size));
+                }
+            }
+            stream.write (text.getData(), text.getDataSize());
+            stream.write (packed.getData(), packed.getDataSize());
+            stream.flush();
+            if (stream.getStatus().failed())
+                return false;
+        }
+        // the old file can't be replaced while it is mapped on every platform
+        close();
+        auto replaced = temporary.overwriteTargetFileWithTemporary();
+        open();
+        return replaced;
+    }
+
+    size_t getEntryOffset (int index) const { return headerSize + static_cast<size_t> (index) * entrySize; }
+    // Where one of an entry's fields lies, or nothing if outside the file
+    Span getSpan (int index, Field field) const
+    {
+        jassert (juce::isPositiveAndBelow (index, numEntries));
+        auto* entry = data + getEntryOffset (index) + 8 + static_cast<size_t> (field) * 8;
+        auto offset = readInt (entry), size = readInt (entry + 4);
+        if (offset < 0 || size < 0 || static_cast<size_t> (offset) + static_cast<size_t> (size) > dataSize)
+            return {};
+        return { static_cast<size_t> (offset), static_cast<size_t> (size) };
+    }
+    static int readInt (const char* source)
+    {
+        return static_cast<int> (juce::ByteOrder::littleEndianInt (source));
+    }
+    static float readFloat (const char* source)
+    {
+        auto bits = juce::ByteOrder::littleEndianInt (source);
+        float value;
+        std::memcpy (&value, &bits, sizeof (value));
+        return value;
+    }
+};
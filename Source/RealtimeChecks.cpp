@@ -0,0 +1,193 @@
+#include "RealtimeChecks.h"
+
+#if ORIOTO_REALTIME_CHECKS
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// The interceptors below replace the allocator, and the locking and blocking
+// calls, for code in this binary. The plugin target is built with hidden
+// visibility, so the host's own calls go straight to the system. Everything
+// reached from inside them must neither allocate nor lock until the reentry
+// guard is set.
+
+#if JUCE_LINUX
+// glibc exports its allocator under these names, so malloc itself can be
+// replaced without looking anything up
+extern "C" void* __libc_malloc (size_t);
+extern "C" void* __libc_calloc (size_t, size_t);
+extern "C" void* __libc_realloc (void*, size_t);
+extern "C" void __libc_free (void*);
+#endif
+
+namespace
+{
+#define ORIOTO_THREAD_STATE __attribute__ ((tls_model ("initial-exec"))) thread_local
+ORIOTO_THREAD_STATE int sectionDepth = 0;
+ORIOTO_THREAD_STATE bool reporting = false;
+#undef ORIOTO_THREAD_STATE
+
+std::atomic<int> numViolations { 0 };
+// the first few are reported with a stack trace, the rest are only counted
+constexpr int maxFullReports = 16;
+
+bool shouldAbort()
+{
+    static const bool abortOnViolation = []
+    {
+        auto* value = std::getenv ("ORIOTO_REALTIME_ABORT");
+        return value != nullptr && value[0] == '1';
+    }();
+    return abortOnViolation;
+}
+
+// operator new and delete go to these, so each call is only reported once
+void* allocate (std::size_t size)
+{
+   #if JUCE_LINUX
+    return __libc_malloc (size);
+   #else
+    return std::malloc (size);
+   #endif
+}
+void release (void* p)
+{
+   #if JUCE_LINUX
+    __libc_free (p);
+   #else
+    std::free (p);
+   #endif
+}
+
+template <typename Function>
+Function next (const char* name)
+{
+    return reinterpret_cast<Function> (dlsym (RTLD_NEXT, name));
+}
+}
+
+namespace op
+{
+void RealtimeChecks::enter() { sectionDepth++; }
+void RealtimeChecks::exit() { sectionDepth--; }
+int RealtimeChecks::getNumViolations() { return numViolations.load(); }
+
+void RealtimeChecks::check (const char* functionName)
+{
+    if (sectionDepth == 0 || reporting)
+        return;
+
+    // reporting allocates, so the interceptors are quiet until it's done
+    reporting = true;
+    auto count = ++numViolations;
+    if (count <= maxFullReports)
+    {
+        std::fprintf (stderr, "Orioto realtime check: %s called from a realtime section\n%s\n",
+                      functionName, juce::SystemStats::getStackBacktrace().toRawUTF8());
+        if (count == maxFullReports)
+            std::fprintf (stderr, "Orioto realtime check: further calls are only counted\n");
+    }
+    if (shouldAbort())
+        std::abort();
+    reporting = false;
+}
+}
+
+//==============================================================================
+void* operator new (std::size_t size)
+{
+    op::RealtimeChecks::check ("operator new");
+    if (auto* p = allocate (size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[] (std::size_t size) { return operator new (size); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept
+{
+    op::RealtimeChecks::check ("operator new");
+    return allocate (size == 0 ? 1 : size);
+}
+void* operator new[] (std::size_t size, const std::nothrow_t& tag) noexcept { return operator new (size, tag); }
+void* operator new (std::size_t size, std::align_val_t alignment)
+{
+    op::RealtimeChecks::check ("operator new");
+    void* p = nullptr;
+    auto minimum = juce::jmax (static_cast<std::size_t> (alignment), sizeof (void*));
+    if (posix_memalign (&p, minimum, size == 0 ? 1 : size) != 0)
+        throw std::bad_alloc();
+    return p;
+}
+void* operator new[] (std::size_t size, std::align_val_t alignment) { return operator new (size, alignment); }
+
+void operator delete (void* p) noexcept
+{
+    if (p != nullptr)
+        op::RealtimeChecks::check ("operator delete");
+    release (p);
+}
+void operator delete[] (void* p) noexcept { operator delete (p); }
+void operator delete (void* p, std::size_t) noexcept { operator delete (p); }
+void operator delete[] (void* p, std::size_t) noexcept { operator delete (p); }
+void operator delete (void* p, const std::nothrow_t&) noexcept { operator delete (p); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept { operator delete (p); }
+void operator delete (void* p, std::align_val_t) noexcept { operator delete (p); }
+void operator delete[] (void* p, std::align_val_t) noexcept { operator delete (p); }
+void operator delete (void* p, std::size_t, std::align_val_t) noexcept { operator delete (p); }
+void operator delete[] (void* p, std::size_t, std::align_val_t) noexcept { operator delete (p); }
+
+//==============================================================================
+#if JUCE_LINUX
+
+extern "C" void* malloc (size_t size)
+{
+    op::RealtimeChecks::check ("malloc");
+    return __libc_malloc (size);
+}
+extern "C" void* calloc (size_t count, size_t size)
+{
+    op::RealtimeChecks::check ("calloc");
+    return __libc_calloc (count, size);
+}
+extern "C" void* realloc (void* p, size_t size)
+{
+    op::RealtimeChecks::check ("realloc");
+    return __libc_realloc (p, size);
+}
+extern "C" void free (void* p)
+{
+    if (p != nullptr)
+        op::RealtimeChecks::check ("free");
+    __libc_free (p);
+}
+#endif
+
+//==============================================================================
+#define ORIOTO_INTERCEPT(returnType, name, parameters, arguments)                          \
+    extern "C" returnType name parameters                                                  \
+    {                                                                                      \
+        op::RealtimeChecks::check (#name);                                                 \
+        static const auto original = next<returnType (*) parameters> (#name);              \
+        return original arguments;                                                         \
+    }
+
+ORIOTO_INTERCEPT (int, pthread_mutex_lock, (pthread_mutex_t* m), (m))
+ORIOTO_INTERCEPT (int, pthread_rwlock_rdlock, (pthread_rwlock_t* l), (l))
+ORIOTO_INTERCEPT (int, pthread_rwlock_wrlock, (pthread_rwlock_t* l), (l))
+ORIOTO_INTERCEPT (int, pthread_cond_wait, (pthread_cond_t* c, pthread_mutex_t* m), (c, m))
+ORIOTO_INTERCEPT (int, pthread_cond_timedwait, (pthread_cond_t* c, pthread_mutex_t* m, const timespec* t), (c, m, t))
+ORIOTO_INTERCEPT (int, pthread_join, (pthread_t t, void** result), (t, result))
+ORIOTO_INTERCEPT (int, sem_wait, (sem_t* s), (s))
+ORIOTO_INTERCEPT (int, usleep, (useconds_t microseconds), (microseconds))
+ORIOTO_INTERCEPT (int, nanosleep, (const timespec* duration, timespec* remaining), (duration, remaining))
+ORIOTO_INTERCEPT (ssize_t, read, (int fd, void* buffer, size_t size), (fd, buffer, size))
+ORIOTO_INTERCEPT (ssize_t, write, (int fd, const void* buffer, size_t size), (fd, buffer, size))
+ORIOTO_INTERCEPT (FILE*, fopen, (const char* path, const char* mode), (path, mode))
+
+#undef ORIOTO_INTERCEPT
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+// Set by the ORIOTO_REALTIME_CHECKS CMake option, for debug and CI builds on
+// Linux and macOS. While a thread is inside a realtime section, allocation,
+// locking and blocking calls made from this plugin's code (JUCE included)
+// are reported on stderr with a stack trace. Setting ORIOTO_REALTIME_ABORT=1
+// in the environment aborts on the first report instead, for CI.
+#ifndef ORIOTO_REALTIME_CHECKS
+ #define ORIOTO_REALTIME_CHECKS 0
+#endif
+
+#if ORIOTO_REALTIME_CHECKS && ! (JUCE_LINUX || JUCE_MAC)
+ #error "ORIOTO_REALTIME_CHECKS is only supported on Linux and macOS"
+#endif
+
+#if ORIOTO_REALTIME_CHECKS
+namespace op
+{
+struct RealtimeChecks
+{
+    // Marks the rest of the enclosing scope as realtime on this thread
+    struct ScopedSection
+    {
+        ScopedSection() { enter(); }
+        ~ScopedSection() { exit(); }
+        JUCE_DECLARE_NON_COPYABLE (ScopedSection)
+    };
+    static void enter();
+    static void exit();
+    // Called by the interceptors, reports the call if inside a section
+    static void check (const char* functionName);
+    static int getNumViolations();
+};
+}
+ #define ORIOTO_REALTIME_SECTION const op::RealtimeChecks::ScopedSection realtimeSection
+#else
+ #define ORIOTO_REALTIME_SECTION JUCE_BLOCK_WITH_FORCED_SEMICOLON (;)
+#endif
@@ -0,0 +1,271 @@
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <iostream>
+#include "../MainProcessor.h"
+#include "../DefaultTreeGenerator.h"
+#include "../CurveFile.h"
+#include "../StateFile.h"
+
+/** OriotoRender: the plugin's processing, without the editor, applied to
+    audio files offline. Files are shared out to a pool of workers, each
+    with its own processor, and the realtime factor of each is reported.
+*/
+namespace
+{
+constexpr int blockSize = 512;
+// rendered past the end of the input, for what rings on after it
+constexpr double tailSeconds = 0.05;
+
+const char* usage =
+    "Usage: OriotoRender [options] input...\n"
+    "\n"
+    "  --state=FILE   plugin state saved from the standalone app (Options > Save current state)\n"
+    "  --curve=FILE   curve file (.oriotocurve or .csv) to use as the active curve\n"
+    "  --output=DIR   where to write the results, beside each input by default\n"
+    "  --format=EXT   wav, aiff or flac, the input's format by default\n"
+    "  --jobs=N       number of workers, one per core by default\n";
+
+struct Settings
+{
+    juce::MemoryBlock state;
+    juce::ValueTree curve;
+    juce::File outputDirectory;
+    juce::String format;
+};
+
+juce::CriticalSection reportLock;
+void report (const juce::String& message)
+{
+    const juce::ScopedLock sl (reportLock);
+    std::cout << message << std::endl;
+}
+
+// Message thread, before any worker starts
+std::unique_ptr<MainProcessor> createProcessor (const Settings& settings)
+{
+    auto processor = std::make_unique<MainProcessor>();
+    processor->setNonRealtime (true);
+    if (! settings.state.isEmpty())
+        processor->setStateInformation (settings.state.getData(), static_cast<int> (settings.state.getSize()));
+    if (settings.curve.isValid())
+    {
+        auto activeCurve = processor->getState().getChildWithName (id::CURVE).getChildWithName (id::ACTIVE_CURVE);
+        CurveBranch::setNodes (activeCurve, CurvePositionCalculator::readNodes (settings.curve), nullptr);
+        processor->getTransferFunction().updateNowIfNeeded();
+    }
+    return processor;
+}
+
+// Renders files from the shared list until none are left
+class RenderWorker : public juce::Thread
+{
+public:
+    RenderWorker (std::unique_ptr<MainProcessor> processorToUse, const juce::Array<juce::File>& filesToRender,
+                  std::atomic<int>& nextFileIndex, const Settings& renderSettings)
+      : juce::Thread ("Orioto Render Worker"),
+        processor (std::move (processorToUse)),
+        files (filesToRender),
+        nextFile (nextFileIndex),
+        settings (renderSettings)
+    {
+        formats.registerBasicFormats();
+    }
+    ~RenderWorker() override
+    {
+        stopThread (-1);
+    }
+    double getAudioSeconds() const { return audioSeconds; }
+    int getNumFailed() const { return numFailed; }
+
+    void run() override
+    {
+        for (auto index = nextFile++; index < files.size() && ! threadShouldExit(); index = nextFile++)
+        {
+            const auto& input = files.getReference (index);
+            auto start = juce::Time::getMillisecondCounterHiRes();
+            double seconds = 0.0;
+            auto error = render (input, seconds);
+            if (error.isNotEmpty())
+            {
+                numFailed++;
+                report (input.getFileName() + ": " + error);
+                continue;
+            }
+            auto elapsed = juce::jmax (1.0e-3, (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0);
+            audioSeconds += seconds;
+            report (input.getFileName() + ": " + juce::String (seconds, 1) + " s of audio in "
+                    + juce::String (elapsed, 2) + " s, " + juce::String (seconds / elapsed, 1) + "x realtime");
+        }
+    }
+private:
+    std::unique_ptr<MainProcessor> processor;
+    const juce::Array<juce::File>& files;
+    std::atomic<int>& nextFile;
+    const Settings& settings;
+    juce::AudioFormatManager formats;
+    double audioSeconds = 0.0;
+    int numFailed = 0;
+
+    // Returns an error message, or an empty string on success
+    juce::String render (const juce::File& input, double& seconds)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (input));
+        if (reader == nullptr)
+            return "can't be read as audio";
+        auto numChannels = static_cast<int> (reader->numChannels);
+        if (numChannels < 1 || numChannels > 2)
+            return "only mono and stereo files can be rendered";
+
+        auto extension = settings.format.isNotEmpty() ? "." + settings.format : input.getFileExtension();
+        auto* format = formats.findFormatForFileExtension (extension);
+        if (format == nullptr)
+            return "can't be written as " + extension;
+
+        auto directory = settings.outputDirectory == juce::File() ? input.getParentDirectory() : settings.outputDirectory;
+        auto output = directory.getChildFile (input.getFileNameWithoutExtension() + " (Orioto)" + extension);
+        // FLAC stops at 24 bits, so float sources are written at the deepest the format takes
+        auto bitDepths = format->getPossibleBitDepths();
+        auto bitsPerSample = static_cast<int> (reader->bitsPerSample);
+        if (! bitDepths.contains (bitsPerSample))
+            bitsPerSample = bitDepths.getLast();
+
+        output.deleteFile();
+        std::unique_ptr<juce::OutputStream> stream (output.createOutputStream());
+        if (stream == nullptr)
+            return "can't write " + output.getFullPathName();
+        std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor (stream.get(), reader->sampleRate,
+                                                                                  static_cast<unsigned int> (numChannels),
+                                                                                  bitsPerSample, {}, 0));
+        if (writer == nullptr)
+            return "can't be written as " + format->getFormatName();
+        stream.release();
+
+        processor->setPlayConfigDetails (2, 2, reader->sampleRate, blockSize);
+        processor->prepareToPlay (reader->sampleRate, blockSize);
+        // the scan bank is built in the background, and has to be there from the first sample
+        juce::SharedResourcePointer<op::BackgroundBuilder>()->waitUntilIdle();
+        // the output starts once the processor's latency has passed, so it
+        // lines up with the input, and the input is followed by that many
+        // samples of silence and the tail, which the reader fills with zeros
+        auto latency = static_cast<juce::int64> (processor->getLatencySamples());
+        auto tail = static_cast<juce::int64> (std::ceil (tailSeconds * reader->sampleRate));
+        auto numToProcess = reader->lengthInSamples + latency + tail;
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::MidiBuffer midi;
+        for (juce::int64 position = 0; position < numToProcess; position += blockSize)
+        {
+            auto numSamples = static_cast<int> (juce::jmin (static_cast<juce::int64> (blockSize), numToProcess - position));
+            buffer.setSize (2, numSamples, false, false, true);
+            reader->read (&buffer, 0, numSamples, position, true, true);
+            // mono files are played into both inputs, and the left output kept
+            if (numChannels == 1)
+                buffer.copyFrom (1, 0, buffer, 0, 0, numSamples);
+            processor->processBlock (buffer, midi);
+            auto skipped = static_cast<int> (juce::jlimit (static_cast<juce::int64> (0), static_cast<juce::int64> (numSamples), latency - position));
+            if (skipped < numSamples && ! writer->writeFromAudioSampleBuffer (buffer, skipped, numSamples - skipped))
+                return "writing " + output.getFullPathName() + " failed";
+        }
+        processor->releaseResources();
+        seconds = static_cast<double> (reader->lengthInSamples) / reader->sampleRate;
+        return {};
+    }
+};
+
+// Fills settings from the options, or returns an error message
+juce::String parseOptions (const juce::ArgumentList& args, Settings& settings)
+{
+    if (args.containsOption ("--state"))
+    {
+        auto file = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--state"));
+        if (! file.loadFileAsData (settings.state)
+            || ! StateFile::read (settings.state.getData(), static_cast<int> (settings.state.getSize())).hasType (id::ORIOTO))
+            return file.getFullPathName() + " isn't an Orioto state";
+    }
+    if (args.containsOption ("--curve"))
+    {
+        auto file = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--curve"));
+        auto error = CurveFile::read (file, settings.curve);
+        if (error.isNotEmpty())
+            return file.getFullPathName() + ": " + error;
+    }
+    if (args.containsOption ("--output"))
+    {
+        settings.outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--output"));
+        if (! settings.outputDirectory.createDirectory())
+            return "can't create " + settings.outputDirectory.getFullPathName();
+    }
+    if (args.containsOption ("--format"))
+    {
+        settings.format = args.getValueForOption ("--format").toLowerCase().trimCharactersAtStart (".");
+        if (! juce::StringArray {"wav", "aiff", "aif", "flac"}.contains (settings.format))
+            return "unknown format " + settings.format;
+    }
+    return {};
+}
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // the processor's trees and timers expect a message thread, which is this one
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args (argc, argv);
+    if (args.size() == 0 || args.containsOption ("--help|-h"))
+    {
+        std::cout << usage;
+        return 0;
+    }
+
+    Settings settings;
+    auto error = parseOptions (args, settings);
+    if (error.isNotEmpty())
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    juce::Array<juce::File> files;
+    for (const auto& argument : args.arguments)
+    {
+        if (argument.isOption())
+            continue;
+        auto file = argument.resolveAsFile();
+        if (! file.existsAsFile())
+        {
+            std::cerr << file.getFullPathName() << " doesn't exist" << std::endl;
+            return 1;
+        }
+        files.add (file);
+    }
+    if (files.isEmpty())
+    {
+        std::cerr << usage;
+        return 1;
+    }
+
+    auto numJobs = args.containsOption ("--jobs") ? args.getValueForOption ("--jobs").getIntValue()
+                                                  : juce::SystemStats::getNumCpus();
+    numJobs = juce::jlimit (1, files.size(), numJobs);
+
+    std::atomic<int> nextFile { 0 };
+    juce::OwnedArray<RenderWorker> workers;
+    for (int i = 0; i < numJobs; i++)
+        workers.add (new RenderWorker (createProcessor (settings), files, nextFile, settings));
+
+    auto start = juce::Time::getMillisecondCounterHiRes();
+    for (auto* worker : workers)
+        worker->startThread();
+    double audioSeconds = 0.0;
+    int numFailed = 0;
+    for (auto* worker : workers)
+    {
+        worker->waitForThreadToExit (-1);
+        audioSeconds += worker->getAudioSeconds();
+        numFailed += worker->getNumFailed();
+    }
+
+    auto elapsed = juce::jmax (1.0e-3, (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0);
+    report ("Rendered " + juce::String (files.size() - numFailed) + " of " + juce::String (files.size()) + " files with "
+            + juce::String (numJobs) + " workers: " + juce::String (audioSeconds, 1) + " s of audio in "
+            + juce::String (elapsed, 2) + " s, " + juce::String (audioSeconds / elapsed, 1) + "x realtime");
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <map>
+#include <unordered_map>
+
+/** The plugin state as saved by the host, in a compact binary form. Every
+    type name, property name and string value is written once to a table and
+    referred to by index, which is where most of the saving over XML comes
+    from. Floats are written as the difference of their bits from the last
+    value of the same property on a branch of the same type: a repeated value
+    costs a byte, but a differing one usually costs three to five. Integers
+    are variable length. Little-endian:
+
+        "ORST", varint version, varint numStrings, numStrings times
+        (varint numBytes, UTF-8), then the root branch as
+        varint type, varint numProperties, per property (varint name,
+        uint8 tag, value), varint numChildren, the children in order
+
+    Trees holding arrays or objects can't be written, and read() falls back
+    to JUCE's binary XML, so states saved before this format still load.
+*/
+struct StateFile
+{
+    // Returns false, leaving destination untouched, if the tree holds a
+    // value this format doesn't cover
+    static bool write (const juce::ValueTree& tree, juce::MemoryBlock& destination)
+    {
+        Writer writer;
+        if (! writer.collectStrings (tree))
+            return false;
+
+        juce::MemoryOutputStream stream (destination, false);
+        stream.writeInt (magic);
+        writeVarint (stream, version);
+        writeVarint (stream, static_cast<juce::uint64> (writer.strings.size()));
+        for (const auto& string : writer.strings)
+        {
+            auto numBytes = string.getNumBytesAsUTF8();
+            writeVarint (stream, static_cast<juce::uint64> (numBytes));
+            stream.write (string.toRawUTF8(), numBytes);
+        }
+        writer.writeBranch (stream, tree);
+        return true;
+    }
+    // Reads either format. Returns an invalid tree if the data is neither.
+    static juce::ValueTree read (const void* data, int sizeInBytes)
+    {
+        if (sizeInBytes >= 4 && static_cast<int> (juce::ByteOrder::littleEndianInt (data)) == magic)
+        {
+            juce::MemoryInputStream stream (data, static_cast<size_t> (sizeInBytes), false);
+            stream.readInt();
+            return Reader().read (stream);
+        }
+        if (auto xml = juce::AudioProcessor::getXmlFromBinary (data, sizeInBytes))
+            return juce::ValueTree::fromXml (*xml);
+        return {};
+    }
+private:
+    static constexpr int magic = ('O' << 0) | ('R' << 8) | ('S' << 16) | ('T' << 24);
+    static constexpr int version = 1;
+    static constexpr int maxDepth = 32;
+
+    enum Tag : juce::uint8 { voidTag, intTag, int64Tag, falseTag, trueTag, floatTag, doubleTag, stringTag, binaryTag };
+
+    static void writeVarint (juce::OutputStream& stream, juce::uint64 value)
+    {
+        while (value >= 0x80)
+        {
+            stream.writeByte (static_cast<char> ((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        stream.writeByte (static_cast<char> (value));
+    }
+    static bool readVarint (juce::InputStream& stream, juce::uint64& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (stream.isExhausted())
+                return false;
+            auto byte = static_cast<juce::uint8> (stream.readByte());
+            value |= static_cast<juce::uint64> (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+    static juce::uint64 zigzag (juce::int64 value)
+    {
+        return (static_cast<juce::uint64> (value) << 1) ^ static_cast<juce::uint64> (value >> 63);
+    }
+    static juce::int64 unzigzag (juce::uint64 value)
+    {
+        return static_cast<juce::int64> (value >> 1) ^ -static_cast<juce::int64> (value & 1);
+    }
+    // Floats are differenced as their bit patterns, so the round trip is exact
+    static juce::uint32 floatToBits (float value)
+    {
+        juce::uint32 bits;
+        std::memcpy (&bits, &value, sizeof (bits));
+        return bits;
+    }
+    static float bitsToFloat (juce::uint32 bits)
+    {
+        float value;
+        std::memcpy (&value, &bits, sizeof (value));
+        return value;
+    }
+    static juce::uint64 makeKey (juce::uint64 type, juce::uint64 name) { return (type << 32) | name; }
+
+    struct Writer
+    {
+        std::vector<juce::String> strings;
+        std::map<juce::String, juce::uint64> indices;
+        std::unordered_map<juce::uint64, juce::uint32> previous;
+
+        juce::uint64 add (const juce::String& string)
+        {
+            auto inserted = indices.emplace (string, static_cast<juce::uint64> (strings.size()));
+            if (inserted.second)
+                strings.push_back (string);
+            return inserted.first->second;
+        }
+        bool collectStrings (const juce::ValueTree& branch)
+        {
+            add (branch.getType().toString());
+            for (int i = 0; i < branch.getNumProperties(); i++)
+            {
+                auto name = branch.getPropertyName (i);
+                const auto& value = branch.getProperty (name);
+                add (name.toString());
+                if (value.isString())
+                    add (value.toString());
+                else if (value.isArray() || value.isObject() || value.isMethod())
+                    return false;
+            }
+            for (const auto& child : branch)
+                if (! collectStrings (child))
+                    return false;
+            return true;
+        }
+        void writeBranch (juce::OutputStream& stream, const juce::ValueTree& branch)
+        {
+            auto type = indices.at (branch.getType().toString());
+            writeVarint (stream, type);
+            writeVarint (stream, static_cast<juce::uint64> (branch.getNumProperties()));
+            for (int i = 0; i < branch.getNumProperties(); i++)
+            {
+                auto name = branch.getPropertyName (i);
+                auto nameIndex = indices.at (name.toString());
+                writeVarint (stream, nameIndex);
+                writeValue (stream, branch.getProperty (name), makeKey (type, nameIndex));
+            }
+            writeVarint (stream, static_cast<juce::uint64> (branch.getNumChildren()));
+            for (const auto& child : branch)
+                writeBranch (stream, child);
+        }
+        void writeValue (juce::OutputStream& stream, const juce::var& value, juce::uint64 key)
+        {
+            if (value.isBool())
+            {
+                stream.writeByte (static_cast<char> (static_cast<bool> (value) ? trueTag : falseTag));
+            }
+            else if (value.isInt())
+            {
+                stream.writeByte (static_cast<char> (intTag));
+                writeVarint (stream, zigzag (static_cast<int> (value)));
+            }
+            else if (value.isInt64())
+            {
+                stream.writeByte (static_cast<char> (int64Tag));
+                writeVarint (stream, zigzag (static_cast<juce::int64> (value)));
+            }
+            else if (value.isDouble())
+            {
+                // values set from floats, which is nearly all of them, fit
+                // exactly and are differenced against the last one
+                auto number = static_cast<double> (value);
+                auto single = static_cast<float> (number);
+                if (juce::exactlyEqual (static_cast<double> (single), number))
+                {
+                    auto bits = floatToBits (single);
+                    auto& last = previous[key];
+                    stream.writeByte (static_cast<char> (floatTag));
+                    writeVarint (stream, zigzag (static_cast<juce::int32> (bits - last)));
+                    last = bits;
+                }
+                else
+                {
+                    stream.writeByte (static_cast<char> (doubleTag));
+                    stream.writeDouble (number);
+                }
+            }
+            else if (value.isString())
+            {
+                stream.writeByte (static_cast<char> (stringTag));
+                writeVarint (stream, indices.at (value.toString()));
+            }
+            else if (auto* block = value.getBinaryData())
+            {
+                stream.writeByte (static_cast<char> (binaryTag));
+                writeVarint (stream, static_cast<juce::uint64> (block->getSize()));
+                stream.write (block->getData(), block->getSize());
+            }
+            else
+            {
+                stream.writeByte (static_cast<char> (voidTag));
+            }
+        }
+    };
+
+    struct Reader
+    {
+        std::vector<juce::Identifier> identifiers;
+        std::vector<juce::String> strings;
+        std::unordered_map<juce::uint64, juce::uint32> previous;
+
+        juce::ValueTree read (juce::InputStream& stream)
+        {
+            juce::uint64 fileVersion = 0, numStrings = 0;
+            if (! readVarint (stream, fileVersion) || fileVersion > version
+                || ! readVarint (stream, numStrings)
+                || numStrings > static_cast<juce::uint64> (stream.getNumBytesRemaining()))
+                return {};
+
+            strings.reserve (static_cast<size_t> (numStrings));
+            identifiers.reserve (static_cast<size_t> (numStrings));
+            for (juce::uint64 i = 0; i < numStrings; i++)
+            {
+                juce::uint64 numBytes = 0;
+                if (! readVarint (stream, numBytes) || numBytes > static_cast<juce::uint64> (stream.getNumBytesRemaining()))
+                    return {};
+                juce::MemoryBlock utf8 (static_cast<size_t> (numBytes));
+                stream.read (utf8.getData(), static_cast<int> (numBytes));
+                strings.push_back (juce::String::fromUTF8 (static_cast<const char*> (utf8.getData()), static_cast<int> (numBytes)));
+                // empty strings can only be values, and Identifier rejects them
+                identifiers.push_back (strings.back().isEmpty() ? juce::Identifier() : juce::Identifier (strings.back()));
+            }
+            juce::ValueTree root;
+            if (! readBranch (stream, root, 0))
+                return {};
+            return root;
+        }
+        bool readIdentifier (juce::InputStream& stream, juce::uint64& index) const
+        {
+            return readVarint (stream, index) && index < identifiers.size() && identifiers[index].isValid();
+        }
+        bool readBranch (juce::InputStream& stream, juce::ValueTree& branch, int depth)
+        {
+            juce::uint64 type = 0, numProperties = 0, numChildren = 0;
+            if (depth > maxDepth || ! readIdentifier (stream, type) || ! readVarint (stream, numProperties))
+                return false;
+
+            branch = juce::ValueTree (identifiers[type]);
+            for (juce::uint64 i = 0; i < numProperties; i++)
+            {
+                juce::uint64 name = 0;
+                juce::var value;
+                if (! readIdentifier (stream, name) || ! readValue (stream, value, makeKey (type, name)))
+                    return false;
+                branch.setProperty (identifiers[name], value, nullptr);
+            }
+
+            if (! readVarint (stream, numChildren) || numChildren > static_cast<juce::uint64> (stream.getNumBytesRemaining()))
+                return false;
+            for (juce::uint64 i = 0; i < numChildren; i++)
+            {
+                juce::ValueTree child;
+                if (! readBranch (stream, child, depth + 1))
+                    return false;
+                branch.appendChild (child, nullptr);
+            }
+            return true;
+        }
+        bool readValue (juce::InputStream& stream, juce::var& value, juce::uint64 key)
+        {
+            juce::uint64 raw = 0;
+            if (stream.isExhausted())
+                return false;
+            auto tag = static_cast<juce::uint8> (stream.readByte());
+            switch (tag)
+            {
+                case voidTag:  value = juce::var(); return true;
+                case falseTag: value = false; return true;
+                case trueTag:  value = true; return true;
+                case intTag:
+                    if (! readVarint (stream, raw))
+                        return false;
+                    value = static_cast<int> (unzigzag (raw));
+                    return true;
+                case int64Tag:
+                    if (! readVarint (stream, raw))
+                        return false;
+                    value = unzigzag (raw);
+                    return true;
+                case floatTag:
+                {
+                    if (! readVarint (stream, raw))
+                        return false;
+                    auto& last = previous[key];
+                    last += static_cast<juce::uint32> (unzigzag (raw));
+                    value = bitsToFloat (last);
+                    return true;
+                }
+                case doubleTag:
+                    if (stream.getNumBytesRemaining() < 8)
+                        return false;
+                    value = stream.readDouble();
+                    return true;
+                case stringTag:
+                    if (! readVarint (stream, raw) || raw >= strings.size())
+                        return false;
+                    value = strings[raw];
+                    return true;
+                case binaryTag:
+                {
+                    if (! readVarint (stream, raw) || raw > static_cast<juce::uint64> (stream.getNumBytesRemaining()))
+                        return false;
+                    juce::MemoryBlock block (static_cast<size_t> (raw));
+                    stream.read (block.getData(), static_cast<int> (raw));
+                    value = block;
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+    };
+};
@@ -0,0 +1,70 @@
+#include <iostream>
+#include "../CurveOperations.h"
+
+/** OriotoCurveOperationsCheck: renders random curves, mixing every segment
+    type, before and after the shape operations that reverse them, and
+    fails if mirroring doesn't reverse the curve, mirroring twice doesn't
+    give it back, or the odd-symmetric curve isn't odd.
+*/
+namespace
+{
+constexpr size_t numPoints = 4097;
+constexpr float tolerance = 1.0e-5f;
+
+std::vector<float> render (const juce::Array<Node>& nodes)
+{
+    auto compiled = nodes;
+    CurvePositionCalculator::resolveSegmentTypes (compiled);
+    std::vector<float> table (numPoints);
+    CurvePositionCalculator::renderTable (compiled, table.data(), table.size());
+    return table;
+}
+
+juce::Array<Node> createRandomCurve (juce::Random& random, bool withCentre)
+{
+    auto numNodes = 3 + random.nextInt (8);
+    juce::Array<Node> nodes;
+    for (int i = 0; i < numNodes; i++)
+    {
+        auto x = juce::jmap (static_cast<float> (i) + (random.nextFloat() - 0.5f) * 0.6f, 0.0f, static_cast<float> (numNodes - 1), -1.0f, 1.0f);
+        if (i == 0 || i == numNodes - 1)
+            x = i == 0 ? -1.0f : 1.0f;
+        else if (withCentre && i == numNodes / 2)
+            x = 0.0f;
+        auto handle = 0.3f / static_cast<float> (numNodes - 1);
+
+        Node node;
+        node.endPoint = {x, random.nextFloat() * 2.0f - 1.0f};
+        node.controlPointOne = node.endPoint - juce::Point<float> (handle, handle * (random.nextFloat() - 0.5f));
+        node.controlPointTwo = node.endPoint * 2.0f - node.controlPointOne;
+        node.type = static_cast<SegmentType> (random.nextInt (segmentTypeNames.size()));
+        nodes.add (node);
+    }
+    return nodes;
+}
+}
+
+int main()
+{
+    juce::Random random (48);
+    float mirrorError = 0.0f, twiceError = 0.0f, oddError = 0.0f;
+    for (int trial = 0; trial < 1000; trial++)
+    {
+        auto nodes = createRandomCurve (random, trial % 2 == 0);
+        auto original = render (nodes);
+        auto mirrored = CurveOperations::mirrorHorizontally (nodes);
+        auto once = render (mirrored);
+        auto twice = render (CurveOperations::mirrorHorizontally (mirrored));
+        auto odd = render (CurveOperations::makeOddSymmetric (nodes));
+        for (size_t i = 0; i < numPoints; i++)
+        {
+            mirrorError = juce::jmax (mirrorError, std::abs (once[i] - original[numPoints - 1 - i]));
+            twiceError = juce::jmax (twiceError, std::abs (twice[i] - original[i]));
+            oddError = juce::jmax (oddError, std::abs (odd[i] + odd[numPoints - 1 - i]));
+        }
+    }
+
+    std::cout << "mirrored: " << mirrorError << ", mirrored twice: " << twiceError
+              << ", odd symmetric: " << oddError << " (largest errors)" << std::endl;
+    return mirrorError < tolerance && twiceError < tolerance && oddError < tolerance ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include <juce_dsp/juce_dsp.h>
+#include <iostream>
+#include "../ChebyshevCurve.h"
+#include "../DSP/CurveCache.h"
+
+/** OriotoHarmonicCheck: fits curves to a few sets of harmonic amplitudes,
+    drives a full scale sine through each compiled 2048 point table as the
+    audio thread reads it, and fails if any of harmonics 2 to 16, relative
+    to the fundamental, is further than the tolerance from its target.
+*/
+namespace
+{
+constexpr size_t numPoints = 2048;
+constexpr int fftOrder = 12;
+constexpr int fftSize = 1 << fftOrder;
+// whole cycles per FFT frame, so every harmonic falls on a bin
+constexpr int numCycles = 8;
+// a little under -50 dB, about twice the worst error of the fit and the table
+constexpr float tolerance = 0.002f;
+
+// The largest difference from the targets of one amplitude set
+float measure (const ChebyshevCurve::Amplitudes& amplitudes, op::CurveCache& cache)
+{
+    auto table = cache.get (ChebyshevCurve::fit (amplitudes), numPoints);
+
+    std::vector<float> data (2 * fftSize);
+    for (int i = 0; i < fftSize; i++)
+    {
+        auto phase = juce::MathConstants<double>::twoPi * numCycles * i / fftSize;
+        auto index = juce::jmap (static_cast<float> (std::sin (phase)), -1.0f, 1.0f, 0.0f, static_cast<float> (numPoints - 1));
+        auto lower = static_cast<size_t> (index);
+        auto fraction = index - static_cast<float> (lower);
+        data[static_cast<size_t> (i)] = (*table)[lower] + fraction * ((*table)[lower + 1] - (*table)[lower]);
+    }
+    juce::dsp::FFT fft (fftOrder);
+    fft.performFrequencyOnlyForwardTransform (data.data());
+
+    auto fundamental = data[numCycles];
+    float error = 0.0f;
+    for (int k = ChebyshevCurve::firstHarmonic; k <= ChebyshevCurve::lastHarmonic; k++)
+    {
+        auto measured = data[static_cast<size_t> (k * numCycles)] / fundamental;
+        auto target = std::abs (amplitudes[static_cast<size_t> (k - ChebyshevCurve::firstHarmonic)]);
+        error = juce::jmax (error, std::abs (measured - target));
+    }
+    return error;
+}
+}
+
+int main()
+{
+    std::vector<ChebyshevCurve::Amplitudes> sets (4);
+    auto set = [&](size_t index, int harmonic, float amplitude)
+        {
+            sets[index][static_cast<size_t> (harmonic - ChebyshevCurve::firstHarmonic)] = amplitude;
+        };
+    set (0, 2, 0.5f);
+    set (1, 3, 0.3f);
+    set (1, 6, 0.2f);
+    set (1, 16, 0.1f);
+    set (2, 5, -0.4f);
+    set (2, 11, 0.25f);
+    for (int k = ChebyshevCurve::firstHarmonic; k <= ChebyshevCurve::lastHarmonic; k++)
+        set (3, k, k % 2 == 0 ? 0.05f : -0.05f);
+
+    op::CurveCache cache;
+    bool passed = true;
+    for (size_t i = 0; i < sets.size(); i++)
+    {
+        auto error = measure (sets[i], cache);
+        std::cout << "amplitude set " << i + 1 << ": largest error " << error
+                  << " of the fundamental (tolerance " << tolerance << ")" << std::endl;
+        passed = passed && error <= tolerance;
+    }
+    return passed ? 0 : 1;
+}
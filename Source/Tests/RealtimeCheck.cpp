@@ -0,0 +1,57 @@
+#include <iostream>
+#include "../MainProcessor.h"
+#include "../DefaultTreeGenerator.h"
+#include "../ChebyshevCurve.h"
+#include "../RealtimeChecks.h"
+
+/** OriotoRealtimeCheck: plays noise through a processor built with
+    ORIOTO_REALTIME_CHECKS while parameters and the active curve change
+    between blocks, as they would from the message thread, and fails if
+    processBlock() or reset() allocated, locked or blocked.
+*/
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numBlocks = 4000;
+
+    MainProcessor processor;
+    processor.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+    processor.prepareToPlay (sampleRate, blockSize);
+    juce::SharedResourcePointer<op::BackgroundBuilder>()->waitUntilIdle();
+
+    auto activeCurve = processor.getState().getChildWithName (id::CURVE).getChildWithName (id::ACTIVE_CURVE);
+    auto& parameters = processor.getParameters();
+    juce::Random random (41);
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    for (int block = 0; block < numBlocks; block++)
+    {
+        if (block % 4 == 0)
+            parameters[random.nextInt (parameters.size())]->setValueNotifyingHost (random.nextFloat());
+        if (block % 32 == 0)
+        {
+            ChebyshevCurve::Amplitudes amplitudes {};
+            for (auto& amplitude : amplitudes)
+                amplitude = random.nextFloat() < 0.3f ? random.nextFloat() * 2.0f - 1.0f : 0.0f;
+            CurveBranch::setNodes (activeCurve, ChebyshevCurve::fit (amplitudes), nullptr);
+            processor.getTransferFunction().updateNowIfNeeded();
+        }
+        if (block % 500 == 499)
+            processor.reset();
+
+        // the variable block sizes some hosts use
+        auto numSamples = random.nextBool() ? blockSize : 1 + random.nextInt (blockSize);
+        buffer.setSize (2, numSamples, false, false, true);
+        for (int channel = 0; channel < 2; channel++)
+            for (int i = 0; i < numSamples; i++)
+                buffer.setSample (channel, i, random.nextFloat() * 2.0f - 1.0f);
+        processor.processBlock (buffer, midi);
+    }
+    processor.releaseResources();
+
+    auto numViolations = op::RealtimeChecks::getNumViolations();
+    std::cout << numBlocks << " blocks processed, " << numViolations << " realtime violations" << std::endl;
+    return numViolations > 0 ? 1 : 0;
+}
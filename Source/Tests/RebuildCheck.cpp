@@ -0,0 +1,77 @@
+#include <iostream>
+#include "../DefaultTreeGenerator.h"
+#include "../DSP/TransferFunctionProcessor.h"
+
+/** OriotoRebuildCheck: writes the tree as a drag does, the endpoint and
+    both handles of a node for each mouse move, and as replacing a curve
+    does, then lets the pending update through as the message loop would.
+    Fails unless each turn compiles the curve exactly once, and a turn with
+    nothing written doesn't compile it at all. The snapshot's version
+    counts the compiles.
+*/
+namespace
+{
+constexpr int numMoves = 100;
+
+void setPoint (juce::ValueTree nodeBranch, const juce::Identifier& type, juce::Point<float> position)
+{
+    auto pointBranch = nodeBranch.getChildWithName (type);
+    pointBranch.setProperty (id::x, position.x, nullptr);
+    pointBranch.setProperty (id::y, position.y, nullptr);
+}
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    auto activeCurve = DefaultTree::create().getChildWithName (id::CURVE).getChildWithName (id::ACTIVE_CURVE);
+    op::TransferFunction transferFunction (activeCurve);
+    auto version = [&]() { return transferFunction.getSnapshot()->version; };
+
+    bool passed = true;
+    auto expectRebuilds = [&](const char* what, int before, int expected)
+        {
+            auto rebuilds = version() - before;
+            std::cout << what << ": " << rebuilds << " compiles (expected " << expected << ")" << std::endl;
+            passed = passed && rebuilds == expected;
+        };
+
+    juce::Random random (42);
+    // a middle node, dragged up and down where it is
+    auto nodeBranch = activeCurve.getChild (activeCurve.getNumChildren() / 2);
+    auto x = static_cast<float> (nodeBranch.getChildWithName (id::endPoint).getProperty (id::x));
+    for (int move = 0; move < numMoves; move++)
+    {
+        auto before = version();
+        auto y = random.nextFloat() * 0.5f - 0.25f;
+        setPoint (nodeBranch, id::endPoint, {x, y});
+        setPoint (nodeBranch, id::controlPoint1, {-0.1f, -y * 0.1f});
+        setPoint (nodeBranch, id::controlPoint2, {0.1f, y * 0.1f});
+        // nothing is compiled until the message loop comes round
+        passed = passed && version() == before;
+        transferFunction.updateNowIfNeeded();
+        passed = passed && version() == before + 1;
+    }
+    std::cout << numMoves << " drag moves: " << (passed ? "one compile each" : "not one compile each") << std::endl;
+
+    auto before = version();
+    transferFunction.updateNowIfNeeded();
+    expectRebuilds ("a turn with nothing written", before, 0);
+
+    juce::Array<Node> nodes;
+    for (int i = 0; i < 9; i++)
+    {
+        auto nodeX = juce::jmap (static_cast<float> (i), 0.0f, 8.0f, -1.0f, 1.0f);
+        Node node;
+        node.endPoint = {nodeX, nodeX * nodeX * nodeX};
+        node.controlPointOne = node.endPoint - juce::Point<float> (0.08f, 0.0f);
+        node.controlPointTwo = node.endPoint + juce::Point<float> (0.08f, 0.0f);
+        nodes.add (node);
+    }
+    before = version();
+    CurveBranch::setNodes (activeCurve, nodes, nullptr);
+    transferFunction.updateNowIfNeeded();
+    expectRebuilds ("replacing a curve", before, 1);
+
+    return passed ? 0 : 1;
+}